@@ -1,3 +1,4 @@
+#define _GNU_SOURCE /* SEEK_DATA, SEEK_HOLE */
 #include <sys/types.h>
 #include <unistd.h>
 #include <stdio.h>
@@ -8,7 +9,19 @@
 #include <fcntl.h>
 #include <errno.h>
 #include <ctype.h>
+#include <wchar.h>
+#include <locale.h>
+#include <limits.h>
 #include <sys/mman.h>
+#include <pthread.h>
+#include <math.h>
+#include <sys/stat.h>
+#include <sys/sendfile.h>
+#include <sys/ioctl.h>
+#include <sys/uio.h>
+#include <linux/fs.h>
+#include <zlib.h>
+#include <lzma.h>
 
 #define CONFIG_ENVVAR   "VEXRC"
 #define CONFIG_USERFILE ".vexrc"
@@ -30,28 +43,417 @@
 #define C_ERROR_IDX 4
 #define C_ERROR COLOR_PAIR(C_ERROR_IDX) | A_BOLD
 
+#define C_SELECT_IDX 5
+#define C_SELECT COLOR_PAIR(C_SELECT_IDX)
+
+#define C_PATCH_IDX 6
+#define C_PATCH COLOR_PAIR(C_PATCH_IDX) | A_BOLD
+
+#define C_NOTE_IDX 7 /* .. 14, one per COLOR_*, on black */
+#define C_NOTE(c) COLOR_PAIR(C_NOTE_IDX + (c))
+
 static void the_colors()
 {
+	int c;
+
 	start_color();
 	init_pair(C_NORMAL_IDX, COLOR_WHITE, COLOR_BLACK);
 	init_pair(C_CURSOR_IDX, COLOR_BLACK, COLOR_WHITE);
 	init_pair(C_STATUS_IDX, COLOR_GREEN, COLOR_BLACK);
 	init_pair(C_ERROR_IDX,  COLOR_WHITE, COLOR_RED);
+	init_pair(C_SELECT_IDX, COLOR_BLACK, COLOR_CYAN);
+	init_pair(C_PATCH_IDX,  COLOR_YELLOW, COLOR_BLACK);
+	for (c = COLOR_BLACK; c <= COLOR_WHITE; c++) {
+		init_pair(C_NOTE_IDX + c, c, COLOR_BLACK);
+	}
 }
 /* }}} */
 /* TYPES {{{ */
+#define T_UNSIGNED 'u'
+#define T_SIGNED   'i'
+#define T_FLOAT    'f'
+#define T_CHAR     'c'
+#define T_HEX      'x'
+
+typedef struct {
+	char    *name;
+	char     type;   /* one of the T_* constants */
+	uint8_t  size;   /* element size, in octets */
+	uint8_t  le;     /* little-endian? (resolved at compile time) */
+	uint32_t offset; /* from the start of the record */
+	uint32_t count;  /* array elements (1 for scalars) */
+} OP;
+
+typedef struct {
+	char   *name;
+	OP     *ops;     /* flat decode program, one op per field */
+	int     nops;
+	size_t  size;    /* record size, in octets */
+} STRUCTDEF;
+
+typedef struct ablock {
+	struct ablock *next;
+	size_t used, size;
+	size_t pad;      /* (keeps what follows 16-octet aligned) */
+} ABLOCK;
+
+typedef struct {
+	ABLOCK *head;    /* the block being handed out from, then older ones */
+} ARENA;
+
 typedef struct {
+	ARENA *arena;    /* everything here (and built from it) lives in this */
 	char *layout;
 	char *status;
+	int   width;     /* octets per row */
+	int   prefetch;  /* PF_* */
+	size_t budget;   /* most octets of the file to keep resident (0 = no limit) */
+
+	STRUCTDEF *structs;
+	int nstructs;
 } CONFIG;
 
+typedef struct {
+	pthread_t tid;
+	int             started;  /* is there a thread to join? */
+	volatile int    done;     /* set by the worker, as it exits */
+	volatile int    cancel;   /* set by the UI, to stop the worker early */
+	volatile size_t progress; /* units of work finished, out of total */
+	size_t          total;
+} JOB;
+
+typedef struct source SOURCE;
+struct source {
+	const char *kind;  /* what sort of image is this? */
+	int (*fill)(SOURCE *, size_t, size_t); /* decode a range into place */
+	void *priv;
+
+	uint8_t *base;     /* reserved mapping; this becomes l->data */
+	size_t reserved;
+	volatile size_t len;   /* decoded length known, so far */
+	volatile int complete; /* is that the final length? */
+	int indexing;      /* is the background indexer running? */
+	JOB job;
+
+	size_t nchunks;
+	uint8_t *flags;    /* per chunk: CHUNK_* flags */
+	uint16_t *pins;    /* per chunk: pin count */
+	size_t *res;       /* resident chunks, in clock order */
+	size_t nres, rescap, hand;
+	size_t budget;     /* most chunks to keep resident */
+	size_t readahead;  /* how many chunks to fill at once */
+	size_t errors;     /* how many fills failed */
+	pthread_mutex_t lock;
+};
+
+typedef struct {
+	SOURCE *src;       /* NULL for plain files; then this is free */
+	size_t off, len;   /* the range that is pinned right now */
+} PINWIN;
+
+typedef struct {
+	size_t start, end; /* [start, end) is allocated; between extents are holes */
+} EXTENT;
+
+#define PF_OFF    0
+#define PF_HINT   1 /* madvise() only */
+#define PF_THREAD 2 /* ... and a thread that faults pages in ahead */
+typedef struct {
+	int mode;          /* one of the PF_* constants */
+	int seen;          /* has there been a view yet? */
+	size_t last;       /* where the last view started */
+	int dir, streak;   /* how many views in a row moved which way */
+	size_t hits;       /* pages that were resident when needed */
+	size_t misses;     /* ... and pages that weren't */
+
+	int running;       /* the prefetch thread (PF_THREAD) */
+	pthread_t tid;
+	pthread_mutex_t lock;
+	pthread_cond_t cv;
+	const uint8_t *data;
+	size_t off, len;   /* what it should read */
+	size_t gen, done;  /* requests made, and the last one handled */
+	int stop;
+} PREFETCH;
+
+typedef struct {
+	int64_t imin, imax; /* integer fields (u64 values are biased) */
+	double  fmin, fmax; /* floating point fields */
+	double  sum;
+	size_t  n;          /* how many values were aggregated */
+} AGG;
+
+typedef struct {
+	STRUCTDEF *def;
+	size_t base;     /* absolute offset of record #0 */
+	size_t stride;   /* distance between records, in octets */
+	size_t nrec;     /* how many (whole) records there are */
+	size_t top;      /* first record on screen */
+	size_t rec;      /* record under the cursor */
+	int *widths;     /* printable width of each field column */
+	WINDOW *win;
+
+	JOB job;         /* background aggregation pass */
+	const uint8_t *data;
+	SOURCE *src;
+	AGG *agg;        /* per-field min / max / sum, one per op */
+	pthread_mutex_t lock; /* guards agg */
+} TABLE;
+
+#define R_SEGMENT 1
+#define R_SECTION 2 /* sections are nested inside segments */
+typedef struct {
+	uint64_t start, end; /* file offsets, [start, end) */
+	size_t   name;       /* offset into the name pool */
+	int      kind;       /* R_SEGMENT or R_SECTION */
+} REGION;
+
+typedef struct {
+	uint64_t offset;     /* file offset */
+	size_t   name;       /* offset into the name pool */
+} SYMBOL;
+
+typedef struct {
+	const char *format;  /* "ELF64", "PE32+", etc. (NULL if none) */
+	REGION   *regions;   /* sorted by start, outermost first */
+	uint64_t *maxend;    /* largest end of regions[0 .. i] */
+	size_t    nregions, regcap;
+	SYMBOL   *syms;
+	size_t    nsyms, symcap;
+	uint32_t *hash;      /* symbols by name: index + 1, 0 = empty */
+	size_t    hashsize;
+	char     *pool;      /* NUL-terminated names */
+	size_t    poollen, poolcap;
+
+	JOB job;             /* background build */
+	const uint8_t *data;
+	size_t len;
+	SOURCE *src;
+	uint64_t pins[16][2]; /* source ranges pinned by the build */
+	size_t npins;
+} INDEX;
+
+typedef struct {
+	uint64_t at;     /* offset and length; see DUP_AT() / DUP_LEN() */
+	uint32_t first;  /* where this block's group of copies starts */
+	uint32_t count;  /* how many copies are in the group */
+} DUPBLOCK;
+
+typedef struct {
+	JOB job;
+	const uint8_t *data;
+	SOURCE *src;
+	size_t size;
+	const EXTENT *ext;
+	size_t nextents;
+
+	DUPBLOCK *blk;   /* duplicated blocks, grouped, each group in offset order */
+	size_t n;
+	uint64_t *byoff; /* offset, blk index pairs, in offset order */
+	size_t groups;   /* distinct blocks with copies */
+	size_t nblocks;  /* blocks cut, all told */
+	int level;       /* 1 in 2^level blocks were kept, to bound memory */
+} DUPS;
+
+#define P_NONE    0
+#define P_STRINGS 1
+#define P_HITS    2
+#define P_PLOT    3
+
+#define STR_ASCII  0
+#define STR_LE     1           /* UTF-16, little endian */
+#define STR_BE     2           /* UTF-16, big endian */
+#define STR_MAXLEN 0x3fffffff
+#define STR_ENC(x) ((x) >> 30)
+#define STR_LEN(x) ((x) & STR_MAXLEN) /* in characters */
+#define STR_FILTER 64
+typedef struct {
+	int min;           /* shortest run worth reporting, in characters */
+	size_t n;          /* how many strings there are */
+	uint64_t *off;     /* where each string starts */
+	uint32_t *len;     /* STR_ENC << 30 | STR_LEN, for each string */
+
+	uint32_t *match;   /* strings that pass the filter, in order */
+	volatile size_t nmatch;
+	char filter[STR_FILTER];
+	int refine;        /* narrow down the previous matches? */
+	int filtered;      /* are the matches complete for the filter? */
+	int stale;         /* filter changed while extracting */
+	int editing;       /* is the filter being typed? */
+	size_t top, sel;   /* first match on screen, match under the cursor */
+	size_t home;       /* where the cursor was, before the pane */
+	WINDOW *win;
+
+	JOB job;           /* extraction */
+	JOB fjob;          /* filtering */
+	const uint8_t *data;
+	size_t size;
+	SOURCE *src;
+	const EXTENT *ext; /* data extents of a sparse file, or NULL */
+	size_t nextents;
+} STRINGS;
+
+#define SCAN_STATES    65536 /* most automaton states (about one per octet) */
+#define SCAN_PATLEN    256
+#define SCAN_PREFILTER 4     /* most distinct first octets, for skipping */
+typedef struct {
+	char     *names;     /* NUL-terminated signature names */
+	size_t    nameslen;
+	size_t   *name;      /* per signature: offset into names */
+	int      *next;      /* per signature: the next with the same pattern */
+	int       nsigs;
+	size_t    maxlen;    /* longest pattern */
+
+	uint32_t (*delta)[256]; /* state transitions */
+	uint32_t *fail;      /* longest proper suffix that is also a state */
+	uint32_t *emit;      /* nearest state on the fail chain that matches */
+	uint32_t *depth;     /* how many octets the state has matched */
+	int      *out;       /* first signature matched at the state, or -1 */
+	size_t    nstates;
+	uint8_t   first[SCAN_PREFILTER]; /* octets that begin a signature */
+	int       nfirst;    /* how many (0 = too many to bother) */
+
+	uint64_t *hits;      /* offset, signature pairs, by offset */
+	size_t    n;
+	volatile int truncated; /* stopped after SCAN_MAXHITS */
+	size_t    top, sel;  /* first hit on screen, hit under the cursor */
+	size_t    home;      /* where the cursor was, before the pane */
+	WINDOW   *win;
+	char      path[256];
+
+	JOB job;
+	const uint8_t *data;
+	size_t size;
+	SOURCE *src;
+	const EXTENT *ext;
+	size_t nextents;
+} SCAN;
+
+#define STRIDE_SAMPLE    65536 /* octets sampled around the cursor */
+#define STRIDE_MAX       4096  /* longest record size looked for */
+#define STRIDE_MIN_SCORE 0.2   /* weaker correlations are just noise */
+
+typedef struct {
+	JOB      job;
+	uint8_t *sample;  /* a copy of the octets around the cursor */
+	size_t   n;
+	size_t   at;      /* where the sample came from */
+	int      period;  /* the record size found (0 = none) */
+	double   score;   /* its normalized autocorrelation */
+	int      noted;   /* has the result been reported yet? */
+} STRIDE;
+
+typedef struct {
+	uint64_t start, end; /* the range annotated, [start, end) */
+	uint64_t reach;      /* the furthest end in its subtree */
+	uint32_t label;      /* where its label starts, in the file */
+	uint16_t len;        /* and how long it is */
+	uint8_t  color;      /* COLOR_*, or COLOR_BLACK for none */
+	uint8_t  _pad;
+} ANNOT;
+
+typedef struct {
+	ANNOT   *a;          /* by start, as an implicit interval tree */
+	size_t   n;
+	int      levels;     /* how tall the tree is */
+	char    *map;        /* the annotations file, mapped */
+	size_t   maplen;
+	uint32_t *paint;     /* per octet on screen: innermost annotation + 1 */
+	size_t   paint_at, paint_len, paint_cap;
+	char     path[256];
+} ANNOTS;
+
+#define PLOT_U      0 /* unsigned integers */
+#define PLOT_S      1 /* signed integers */
+#define PLOT_F      2 /* IEEE floats */
+#define PLOT_LEVELS 40
+typedef struct {
+	JOB     job;       /* building the pyramid */
+	int     kind;      /* PLOT_U, PLOT_S or PLOT_F */
+	int     bits;      /* sample width: 8, 16, 32 or 64 */
+	size_t  at;        /* where the series starts */
+	size_t  n;         /* how many samples it has */
+	float  *lo[PLOT_LEVELS]; /* level k: extremes of every PLOT_LEAF << k samples */
+	float  *hi[PLOT_LEVELS];
+	size_t  count[PLOT_LEVELS];
+	int     levels;
+	size_t  first;     /* first sample on screen (a multiple of 2^zoom) */
+	size_t  cur;       /* sample under the cursor */
+	int     zoom;      /* log2 of the samples per column of dots */
+	size_t  home;      /* where the cursor was, before the pane */
+	WINDOW *win;
+	const uint8_t *data;
+	SOURCE *src;
+} PLOT;
+
+#define CARVE_STEP (16 << 20) /* octets per call, between progress updates */
+typedef struct {
+	JOB      job;
+	int      in;      /* the file, for copying without reading it (-1 = no) */
+	int      out;
+	const uint8_t *data; /* ... or else, where to write() from */
+	SOURCE  *src;
+	size_t   off, len;
+	int      err;     /* errno, if it failed */
+	const char *how;  /* the last way of copying that worked */
+	EXTENT  *patch;   /* patched ranges to write over the copy */
+	size_t   npatch;
+	int      noted;   /* has the result been reported yet? */
+	int      whole;   /* is it the whole file (so it can be reflinked)? */
+	char     path[256];
+	char     tmp[264]; /* written first, then renamed over path */
+} CARVE;
+
+#define PAT_EXACT   0
+#define PAT_HAMMING 1 /* at most k octets differ */
+#define PAT_EDIT    2 /* at most k insertions, deletions or substitutions */
+#define PAT_MASK    3 /* octets, some of whose nibbles don't matter */
+#define PAT_XOR     4 /* under any single-octet key ... */
+#define PAT_ADD     5
+#define PAT_ROL     6
+#define PAT_KEYED   7 /* ... of any of those kinds */
+#define PAT_BITS    8 /* a string of bits, at any bit offset */
+#define BITS_MAX    256
+typedef struct {
+	int kind;             /* PAT_* */
+	int k;                /* how many differences are allowed */
+	const uint8_t *bytes; /* what to look for */
+	size_t len;
+	uint64_t eq[2][256];  /* octet -> positions it occurs at, forwards and reversed */
+	uint8_t dx[64], da[64]; /* differences between neighbouring octets */
+	uint8_t rot[256];     /* octet -> rotations of bytes[0] that it is */
+	uint8_t bpat[8][BITS_MAX / 8 + 8]; /* the bits, shifted right by 0 .. 7 */
+	uint8_t bmsk[8][BITS_MAX / 8 + 8]; /* which of those bits matter */
+	int blen[8];          /* how many octets each shift spans */
+	long skip_at;         /* the octet under a bit cursor ... */
+	int skip_bits;        /* ... and the shifts (1 << s) in it not to match */
+	int hit_bit;          /* the shift that matched */
+} PATTERN;
+
+#define BITS_UPTO(b) ((2 << (b)) - 1)       /* shifts 0 .. b */
+#define BITS_FROM(b) (0xff & (0xff << (b))) /* shifts b .. 7 */
+
+#define KEY_NONE 0
+#define KEY_XOR  1
+#define KEY_ADD  2
+#define KEY_ROL  3
+
+#define CURSOR_MAX 256 /* most octets the status bar decodes at a bit offset */
+
 typedef void (*prcell_fn)(WINDOW *w, uint8_t v);
 typedef struct {
 	WINDOW     *win;
 	prcell_fn   pr;
 	int         width; /* cell width, in printable columns */
+	int         space; /* trailing blank columns, in each cell */
+	int         keyed; /* show octets decoded with the layout's key */
+	int         text;  /* decode rows as TEXT_UTF8, TEXT_UTF16LE, etc. */
 } COLUMN;
 
+#define TEXT_UTF8    1
+#define TEXT_UTF16LE 2
+#define TEXT_UTF16BE 3
+
 typedef void (*fmt_fn)(void *, int, void *);
 typedef struct {
 	fmt_fn  fmt;
@@ -70,6 +472,26 @@ typedef struct {
 
 	WINDOW *command; /* the command window (errors, search, etc. */
 
+	STRUCTDEF *structs;
+	int nstructs;
+	int record;      /* struct shown in the record panel (-1 = none) */
+	WINDOW *panel;   /* the record panel window (for drawing) */
+	int panel_x;     /* screen column where the record panel starts */
+	char *decoded;   /* formatted field values, DECODED_MAX per op */
+	size_t decoded_at; /* absolute offset of the decoded record */
+	TABLE *table;    /* the table view, if active */
+	INDEX *index;    /* segments, sections and symbols (built lazily) */
+	STRINGS *strings; /* extracted strings, if any */
+	SCAN *scan;      /* the last signature scan, if any */
+	STRIDE *stride;  /* the last record size detection, if any */
+	DUPS *dups;      /* duplicated blocks (found on first use) */
+	CARVE *carve;    /* the last :write, if any */
+	PLOT *plot;      /* the last :plot, if any */
+	ANNOTS *annots;  /* labelled ranges, from :annotate */
+	int pane;        /* which list pane covers the hex view (P_*) */
+	int keyop;       /* how keyed columns are decoded (KEY_*) */
+	uint8_t key;
+
 	const char *path;
 	const char *file;
 
@@ -78,8 +500,25 @@ typedef struct {
 
 	uint8_t *data;   /* the data mmap pointer */
 	size_t len;      /* how much data is there? */
+	int fd;          /* the file that's open */
+	SOURCE *src;     /* where the data comes from, if not a plain file */
+	CONFIG *config;  /* what the layout was built from */
+	size_t budget;   /* most octets to keep resident (0 = no limit) */
+	EXTENT *extents; /* allocated extents, if the file has holes */
+	size_t nextents;
+	PREFETCH pf;     /* read-ahead, for plain files */
+	size_t vpin_off, vpin_len; /* what lview() has pinned */
 	size_t offset;   /* offset (to data) of first printed octet */
-	int pos;         /* cursor position, counting from l->offset */
+	size_t pos;      /* cursor position, counting from l->offset */
+	int bit;         /* bit offset into the octet at the cursor (0 = MSB) */
+	int patching;    /* can the data be changed (:patch)? */
+	EXTENT *dirty;   /* patched ranges, by offset, not yet saved in place */
+	size_t ndirty;
+	int quitting;    /* has 'q' warned about unsaved patches? */
+	int marking;     /* is there a visual selection? */
+	int interruptible; /* should searches give up when a key is pressed? */
+	size_t mark;     /* where it started; the cursor is the other end */
+	uint8_t curbuf[CURSOR_MAX]; /* the octets from that bit on, for lcursor() */
 } LAYOUT;
 /* }}} */
 /* utility functions {{{ */
@@ -87,6 +526,8 @@ typedef struct {
 #define min(a,b) ((a) < (b) ? (a) : (b))
 #define DATA_AT(l,plus) (DATA(l) + (plus))
 #define DATA(l) ((l)->data + (l)->offset)
+#define CURSOR(l) lcursor(l)
+#define LEFT(l) ((l)->len - ((l)->offset + (l)->pos) - ((l)->bit ? 1 : 0))
 #define as(t,x) (*(t *)(x))
 #define as_u8(x)  as(uint8_t,  x)
 #define as_i8(x)  as(int8_t,   x)
@@ -190,932 +631,8277 @@ int clz64(uint64_t x)
 #define ctz32(x) (32 - clz32(~(x) & ((x)-1)))
 #define ctz64(x) (64 - clz64(~(x) & ((x)-1)))
 
-static void anyexit(int rc)
+static int native_le()
 {
-	printw("press any key to exit...");
-	refresh();
-	getch();
-	endwin();
-	exit(rc);
+	uint8_t buf[2] = { 0xba, 0xab };
+	return as_u16(buf) != 0xbaab;
 }
 
-int cfgcol(LAYOUT *l, COLUMN *c, prcell_fn pr, int x, int width, int space)
+static uint64_t peek_uint(const uint8_t *p, int size, int le)
 {
-	c->pr    = pr;
-	c->width = width;
-	c->win   = newwin(LINES, c->width * l->width, 0, x);
-	return c->width * l->width + GUTTER - space;
+	uint64_t v;
+	int i;
+
+	v = 0;
+	for (i = 0; i < size; i++) {
+		v |= (uint64_t)p[i] << (8 * (le ? i : size - 1 - i));
+	}
+	return v;
 }
 
-void errorf(LAYOUT * l, const char *msg, ...)
+static uint8_t rol8(uint8_t v, int r)
 {
-	va_list ap;
-
-	wattron(l->command, C_ERROR);
-	werase(l->command);
-	wmove(l->command, 0, 0);
-
-	va_start(ap, msg);
-	vwprintw(l->command, msg, ap);
-	va_end(ap);
-
-	wattroff(l->command, C_ERROR);
-	wrefresh(l->command);
+	return r ? (uint8_t)(v << r | v >> (8 - r)) : v;
 }
-/* }}} */
 
-static void pr_ascii(WINDOW *w, uint8_t v) /* {{{ */
+/* undoes the layout's key, for keyed columns */
+uint8_t unkey(LAYOUT *l, uint8_t v)
 {
-	if (v < 32 || v > 126) {
-		waddch(w, '.');
-	} else {
-		waddch(w, v);
+	switch (l->keyop) {
+	case KEY_XOR: return v ^ l->key;
+	case KEY_ADD: return v - l->key;
+	case KEY_ROL: return rol8(v, (8 - l->key) & 7);
+	default:      return v;
 	}
 }
-/* }}} */
-static void pr_hex(WINDOW *w, uint8_t v) /* {{{ */
+
+/* sizes like 512M, for people; K, M, G and T are powers of 1024 */
+static void hsize(char *buf, size_t n, uint64_t v)
 {
-	wprintw(w, "%02x", v);
-	wattroff(w, C_CURSOR);
-	waddch(w, ' ');
+	const char *units = "KMGT";
+	double x;
+	int i;
+
+	if (v < 1024) {
+		snprintf(buf, n, "%luB", (unsigned long)v);
+		return;
+	}
+	for (x = v / 1024.0, i = 0; x >= 1024 && units[i + 1]; x /= 1024, i++);
+	snprintf(buf, n, x < 10 ? "%.1f%c" : "%.0f%c", x, units[i]);
 }
-/* }}} */
-static void pr_hex_pretty(WINDOW *w, uint8_t v) /* {{{ */
+
+static int parse_size(const char *s, uint64_t *v)
 {
-	if (v == 0) {
-		waddch(w, '-');
-		waddch(w, ' ');
-	} else {
-		wattron(w, A_BOLD);
-		wprintw(w, "%02x", v);
-		wattroff(w, A_BOLD);
+	char *end;
+	int shift;
+
+	*v = strtoull(s, &end, 0);
+	if (end == s) return -1;
+	switch (toupper(*end)) {
+	case 'K': shift = 10; end++; break;
+	case 'M': shift = 20; end++; break;
+	case 'G': shift = 30; end++; break;
+	case 'T': shift = 40; end++; break;
+	default:  shift = 0;         break;
 	}
-	wattroff(w, C_CURSOR);
-	waddch(w, ' ');
+	for (; isspace(*end); end++);
+	if (*end || *v > (UINT64_MAX >> shift)) return -1;
+	*v <<= shift;
+	return 0;
 }
-/* }}} */
-static void pr_oct(WINDOW *w, uint8_t v) /* {{{ */
+
+/* An arena hands out memory that is all given back at once.  The
+   configuration, and everything the layout builds from it, lives in
+   one, so a reload builds a new one and drops the old. */
+#define ARENA_BLOCK 4096
+ARENA* arena_new(void)
 {
-	wprintw(w, "% 3o", v);
-	wattroff(w, C_CURSOR);
-	waddch(w, ' ');
+	return calloc(1, sizeof(ARENA));
 }
-/* }}} */
-static void pr_oct_pretty(WINDOW *w, uint8_t v) /* {{{ */
+
+void* arena_alloc(ARENA *a, size_t n)
 {
-	if (v == 0) {
-		waddch(w, ' ');
-		waddch(w, '-');
-		waddch(w, ' ');
-	} else {
-		wattron(w, A_BOLD);
-		wprintw(w, "% 3o", v);
-		wattroff(w, A_BOLD);
+	ABLOCK *b;
+	void *p;
+
+	n = (n + 15) & ~(size_t)15;
+	b = a->head;
+	if (!b || b->size - b->used < n) {
+		b = malloc(sizeof(ABLOCK) + max(n, ARENA_BLOCK));
+		if (!b) return NULL;
+		b->next = a->head;
+		b->used = 0;
+		b->size = max(n, ARENA_BLOCK);
+		a->head = b;
 	}
-	wattroff(w, C_CURSOR);
-	waddch(w, ' ');
+	p = (char *)(b + 1) + b->used;
+	b->used += n;
+	return memset(p, 0, n);
 }
-/* }}} */
 
-static void fmt_literal(void *l, int width, void *_field) /* {{{ */
+/* arenas don't grow things in place; this copies into a bigger one */
+void* arena_grow(ARENA *a, void *old, size_t had, size_t n)
 {
-	wprintw(((LAYOUT *)l)->status, "%s", ((FIELD*)_field)->literal);
-} /* }}} */
-static void fmt_ud(void *_, int width, void *_field) /* {{{ */
+	void *p;
+
+	p = arena_alloc(a, n);
+	if (p && old) memcpy(p, old, min(had, n));
+	return p;
+}
+
+char* arena_strndup(ARENA *a, const char *s, size_t n)
 {
-	int left;
-	LAYOUT *l;
+	char *p;
 
-	l = (LAYOUT*)_;
-	left = l->len - (l->offset + l->pos);
+	p = arena_alloc(a, n + 1);
+	if (p) memcpy(p, s, n);
+	return p;
+}
 
-	switch (width) {
-	case 8:
-		wprintw(l->status, "% 3u", as_u8(DATA_AT(l, l->pos)));
-		break;
+char* arena_strdup(ARENA *a, const char *s)
+{
+	return arena_strndup(a, s, strlen(s));
+}
 
-	case 16:
-		if (left >= 2) wprintw(l->status, "% 6u", as_u16(DATA_AT(l, l->pos)));
-		else           wprintw(l->status, "% 6s", "");
-		break;
-	case 32:
-		if (left >= 4) wprintw(l->status, "% 11u", as_u32(DATA_AT(l, l->pos)));
-		else           wprintw(l->status, "% 11s", "");
-		break;
+void arena_free(ARENA *a)
+{
+	ABLOCK *b, *next;
 
-	case 64:
-		if (left >= 8) wprintw(l->status, "% 20lu", as_u64(DATA_AT(l, l->pos)));
-		else           wprintw(l->status, "% 20s", "");
-		break;
+	if (!a) return;
+	for (b = a->head; b; b = next) {
+		next = b->next;
+		free(b);
+	}
+	free(a);
+}
 
-	default:
-		wprintw(l->status, "!!!");
-		break;
+/* background jobs {{{ */
+int job_start(JOB *j, void *(*fn)(void *), void *arg)
+{
+	int rc;
+
+	j->done     = 0;
+	j->cancel   = 0;
+	j->progress = 0;
+	rc = pthread_create(&j->tid, NULL, fn, arg);
+	if (rc != 0) {
+		errno = rc;
+		return -1;
 	}
-} /* }}} */
-static void fmt_sd(void *_, int width, void *_field) /* {{{ */
+	j->started = 1;
+	return 0;
+}
+
+/* cancels the job and waits for it; safe on jobs that never started */
+void job_stop(JOB *j)
 {
-	int left;
-	LAYOUT *l;
+	if (!j->started) return;
+	j->cancel = 1;
+	pthread_join(j->tid, NULL);
+	j->started = 0;
+}
 
-	l = (LAYOUT*)_;
-	left = l->len - (l->offset + l->pos);
+/* how many threads a parallel pass should split into */
+int nworkers(int most)
+{
+	long n;
 
-	switch (width) {
-	case 8:
-		wprintw(l->status, "% 3i", as_i8(DATA_AT(l, l->pos)));
-		break;
+	n = sysconf(_SC_NPROCESSORS_ONLN);
+	return min(max(n, 1), most);
+}
+/* }}} */
+/* data sources {{{ */
+/* Decoded sources (compressed images, for now) can't be mapped
+   straight from disk.  Instead, we reserve an anonymous mapping for
+   the whole decoded image, and fill it in on demand, SRC_CHUNK octets
+   at a time.  Callers pin the ranges they are about to read; only
+   unpinned chunks are evicted (clock order) once more than `budget`
+   chunks are resident. */
+#define SRC_CHUNK     (1 << 20)
+#define SRC_BUDGET    256          /* default resident bound, in chunks */
+#define SRC_RESERVE   (1UL << 44)  /* most address space we'll reserve */
+
+#define CHUNK_RESIDENT 0x01
+#define CHUNK_REF      0x02
+
+static int src_grow(SOURCE *s, size_t len)
+{
+	size_t n;
+	uint8_t *flags;
+	uint16_t *pins;
+
+	n = (len + SRC_CHUNK - 1) / SRC_CHUNK;
+	if (n > s->nchunks) {
+		flags = realloc(s->flags, n * sizeof(uint8_t));
+		pins  = realloc(s->pins,  n * sizeof(uint16_t));
+		if (flags) s->flags = flags;
+		if (pins)  s->pins  = pins;
+		if (!flags || !pins) return -1;
+
+		memset(s->flags + s->nchunks, 0, (n - s->nchunks) * sizeof(uint8_t));
+		memset(s->pins  + s->nchunks, 0, (n - s->nchunks) * sizeof(uint16_t));
+		s->nchunks = n;
+	}
+	s->len = len;
+	return 0;
+}
 
-	case 16:
-		if (left >= 2) wprintw(l->status, "% 6i", as_i16(DATA_AT(l, l->pos)));
-		else           wprintw(l->status, "% 6s", "");
-		break;
-	case 32:
-		if (left >= 4) wprintw(l->status, "% 11i", as_i32(DATA_AT(l, l->pos)));
-		else           wprintw(l->status, "% 11s", "");
-		break;
+static void src_evict(SOURCE *s)
+{
+	size_t c, tries;
 
-	case 64:
-		if (left >= 8) wprintw(l->status, "% 20li", as_i64(DATA_AT(l, l->pos)));
-		else           wprintw(l->status, "% 20s", "");
-		break;
+	for (tries = 0; s->nres > s->budget && tries < 2 * s->nres; tries++) {
+		if (s->hand >= s->nres) s->hand = 0;
+		c = s->res[s->hand];
+		if (s->pins[c]) {
+			s->hand++;
+			continue;
+		}
+		if (s->flags[c] & CHUNK_REF) { /* second chance */
+			s->flags[c] &= ~CHUNK_REF;
+			s->hand++;
+			continue;
+		}
 
-	default:
-		wprintw(l->status, "!!!");
-		break;
+		madvise(s->base + c * SRC_CHUNK, SRC_CHUNK, MADV_DONTNEED);
+		s->flags[c] = 0;
+		s->res[s->hand] = s->res[--s->nres];
 	}
-} /* }}} */
-static void fmt_lz(void *_, int width, void *_field) /* {{{ */
+}
+
+/* out of memory, the chunk just isn't resident: it's filled again
+   the next time it's pinned */
+static void src_mark(SOURCE *s, size_t c)
 {
-	int left;
-	LAYOUT *l;
+	size_t *res, cap;
 
-	l = (LAYOUT*)_;
-	left = l->len - (l->offset + l->pos);
+	if (s->flags[c] & CHUNK_RESIDENT) return;
 
-	switch (width) {
-	case 8:
-		wprintw(l->status, "%i", clz8(as_u8(DATA_AT(l, l->pos))));
-		break;
-	case 16:
-		if (left >= 2) wprintw(l->status, "% 2i", clz16(as_u16(DATA_AT(l, l->pos))));
-		else           wprintw(l->status, "  ");
-		break;
-	case 32:
-		if (left >= 4) wprintw(l->status, "% 2i", clz32(as_u32(DATA_AT(l, l->pos))));
-		else           wprintw(l->status, "  ");
-		break;
-	case 64:
-		if (left >= 4) wprintw(l->status, "% 2i", clz64(as_u64(DATA_AT(l, l->pos))));
-		else           wprintw(l->status, "  ");
-		break;
-	default:
-		wprintw(l->status, "!!!");
-		break;
+	if (s->nres == s->rescap) {
+		cap = s->rescap ? s->rescap * 2 : 64;
+		res = realloc(s->res, cap * sizeof(size_t));
+		if (!res) return;
+		s->res    = res;
+		s->rescap = cap;
 	}
-} /* }}} */
-static void fmt_tz(void *_, int width, void *_field) /* {{{ */
+	s->res[s->nres++] = c;
+	s->flags[c] = CHUNK_RESIDENT | CHUNK_REF;
+}
+
+/* make [off, off+len) readable, and keep it that way until unpinned */
+void src_pin(SOURCE *s, size_t off, size_t len)
 {
-	int left;
-	LAYOUT *l;
+	size_t c, c0, c1, end;
 
-	l = (LAYOUT*)_;
-	left = l->len - (l->offset + l->pos);
+	pthread_mutex_lock(&s->lock);
+	if (len == 0 || off >= s->len) {
+		pthread_mutex_unlock(&s->lock);
+		return;
+	}
+	if (len > s->len - off) len = s->len - off;
 
-	switch (width) {
-	case 8:
-		wprintw(l->status, "%i", ctz8(as_u8(DATA_AT(l, l->pos))));
-		break;
-	case 16:
-		if (left >= 2) wprintw(l->status, "% 2i", ctz16(as_u16(DATA_AT(l, l->pos))));
-		else           wprintw(l->status, "  ");
-		break;
-	case 32:
-		if (left >= 4) wprintw(l->status, "% 2i", ctz32(as_u32(DATA_AT(l, l->pos))));
-		else           wprintw(l->status, "  ");
-		break;
-	case 64:
-		if (left >= 4) wprintw(l->status, "% 2i", ctz64(as_u64(DATA_AT(l, l->pos))));
-		else           wprintw(l->status, "  ");
-		break;
-	default:
-		wprintw(l->status, "!!!");
-		break;
+	c0 = off / SRC_CHUNK;
+	c1 = (off + len - 1) / SRC_CHUNK;
+	for (c = c0; c <= c1; c++) {
+		s->pins[c]++;
 	}
-} /* }}} */
-static void fmt_p(void *_, int width, void *_field) /* {{{ */
-{
-	int left;
-	LAYOUT *l;
 
-	l = (LAYOUT*)_;
-	left = l->len - (l->offset + l->pos);
+	for (c = c0; c <= c1; c++) {
+		if (s->flags[c] & CHUNK_RESIDENT) {
+			s->flags[c] |= CHUNK_REF;
+			continue;
+		}
+		/* fill the whole run of missing chunks at once, reading ahead
+		   as far as the source says is cheap to do so */
+		for (end = c + 1; end < s->nchunks && !(s->flags[end] & CHUNK_RESIDENT)
+		               && (end <= c1 || end - c < s->readahead); end++);
+
+		if ((*s->fill)(s, c * SRC_CHUNK, min(end * SRC_CHUNK, s->len) - c * SRC_CHUNK) != 0) {
+			s->errors++; /* not resident: it's tried again next time */
+			c = end - 1;
+			continue;
+		}
+		/* a chunk cut short by a stream that's still growing gets
+		   the rest of itself later, so it can't be resident yet */
+		for (; c < end && (c + 1) * SRC_CHUNK <= s->len; c++) {
+			src_mark(s, c);
+		}
+		if (c < end && s->complete) src_mark(s, c++);
+		c = end - 1;
+	}
 
-	switch (width) {
-	case 8:
-		wprintw(l->status, "%i", pop8(as_u8(DATA_AT(l, l->pos))));
-		break;
+	src_evict(s);
+	pthread_mutex_unlock(&s->lock);
+}
+
+void src_unpin(SOURCE *s, size_t off, size_t len)
+{
+	size_t c, c0, c1;
+
+	pthread_mutex_lock(&s->lock);
+	if (len == 0 || off >= s->len) {
+		pthread_mutex_unlock(&s->lock);
+		return;
+	}
+	if (len > s->len - off) len = s->len - off;
+
+	c0 = off / SRC_CHUNK;
+	c1 = (off + len - 1) / SRC_CHUNK;
+	for (c = c0; c <= c1; c++) {
+		if (s->pins[c]) s->pins[c]--;
+	}
+	pthread_mutex_unlock(&s->lock);
+}
+
+/* reads the resident chunks of [off, off + len) again, for sources
+   whose contents can change underneath us */
+void src_refill(SOURCE *s, size_t off, size_t len)
+{
+	size_t c, c0, c1;
+
+	pthread_mutex_lock(&s->lock);
+	if (len && off < s->len) {
+		if (len > s->len - off) len = s->len - off;
+		c0 = off / SRC_CHUNK;
+		c1 = (off + len - 1) / SRC_CHUNK;
+		for (c = c0; c <= c1; c++) {
+			if (!(s->flags[c] & CHUNK_RESIDENT)) continue;
+			if ((*s->fill)(s, c * SRC_CHUNK, min((c + 1) * SRC_CHUNK, s->len) - c * SRC_CHUNK) != 0) {
+				s->errors++;
+			}
+		}
+	}
+	pthread_mutex_unlock(&s->lock);
+}
+
+static SOURCE* src_new(const char *kind, size_t reserve)
+{
+	SOURCE *s;
+
+	s = calloc(1, sizeof(SOURCE));
+	if (!s) return NULL;
+
+	s->kind      = kind;
+	s->budget    = SRC_BUDGET;
+	s->readahead = 1;
+	s->reserved  = min((reserve + SRC_CHUNK - 1) / SRC_CHUNK * SRC_CHUNK, SRC_RESERVE);
+	s->base = mmap(NULL, s->reserved, PROT_READ | PROT_WRITE,
+	               MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if (s->base == MAP_FAILED) {
+		free(s);
+		return NULL;
+	}
+	pthread_mutex_init(&s->lock, NULL);
+	return s;
+}
+
+/* undoes src_new() (and any src_grow()), for opens that fail after it */
+static void src_discard(SOURCE *s)
+{
+	munmap(s->base, s->reserved);
+	pthread_mutex_destroy(&s->lock);
+	free(s->flags);
+	free(s->pins);
+	free(s->res);
+	free(s);
+}
+
+/* where persisted indexes live: $XDG_CACHE_HOME/vex or ~/.cache/vex */
+static int cachepath(char *buf, size_t n, const struct stat *st, const char *ext)
+{
+	const char *dir;
+	int k;
+
+	dir = getenv("XDG_CACHE_HOME");
+	if (dir && *dir) {
+		k = snprintf(buf, n, "%s/vex", dir);
+	} else {
+		dir = getenv("HOME");
+		if (!dir) return -1;
+		k = snprintf(buf, n, "%s/.cache", dir);
+		if (k >= n) return -1;
+		mkdir(buf, 0777);
+		k = snprintf(buf, n, "%s/.cache/vex", dir);
+	}
+	if (k >= n) return -1;
+	mkdir(buf, 0777);
+
+	k = snprintf(buf + k, n - k, "/%lx-%lx.%s", (unsigned long)st->st_dev,
+	                                             (unsigned long)st->st_ino, ext);
+	return k < n ? 0 : -1;
+}
+/* slides a pinned window along with a pass through a source, so that
+   [off, off + len) is resident; windows are at least SRC_CHUNK long */
+void pw_need(PINWIN *w, size_t off, size_t len)
+{
+	if (!w->src || (w->len && off >= w->off && off + len <= w->off + w->len)) return;
+
+	len = max(len, SRC_CHUNK);
+	src_pin(w->src, off, len); /* before unpinning, so shared chunks stay */
+	if (w->len) src_unpin(w->src, w->off, w->len);
+	w->off = off;
+	w->len = len;
+}
+
+void pw_done(PINWIN *w)
+{
+	if (w->src && w->len) src_unpin(w->src, w->off, w->len);
+	w->len = 0;
+}
+
+/* Sparse files are mostly holes, which read as zeros without being
+   stored anywhere.  Passes over the data skip them, bar `pad` octets
+   either side of each extent, for whatever straddles the edges. */
+
+/* the first offset at or after `at` that is within `pad` of allocated
+   data (SIZE_MAX if there is none); *stop is where that stretch ends */
+size_t ext_next(const EXTENT *e, size_t n, size_t at, size_t pad, size_t *stop)
+{
+	size_t lo, hi, mid;
+
+	*stop = SIZE_MAX;
+	if (!e) return at;
+
+	for (lo = 0, hi = n; lo < hi; ) {
+		mid = (lo + hi) / 2;
+		if (e[mid].end + pad <= at) lo = mid + 1;
+		else                        hi = mid;
+	}
+	if (lo == n) return SIZE_MAX;
+	*stop = e[lo].end + pad;
+	return max(at, e[lo].start > pad ? e[lo].start - pad : 0);
+}
+
+/* the same, walking backwards: the last offset at or before `at` within
+   `pad` of data (-1 if none); *stop is the offset just below it */
+long ext_prev(const EXTENT *e, size_t n, long at, size_t pad, long *stop)
+{
+	size_t lo, hi, mid;
+
+	*stop = -1;
+	if (!e) return at;
+
+	for (lo = 0, hi = n; lo < hi; ) {
+		mid = (lo + hi) / 2;
+		if ((long)e[mid].start - (long)pad <= at) lo = mid + 1;
+		else                                      hi = mid;
+	}
+	if (lo == 0) return -1;
+	*stop = max((long)e[lo - 1].start - (long)pad - 1, -1);
+	return min(at, (long)(e[lo - 1].end + pad) - 1);
+}
+
+/* finds the data extents of a sparse file; files without holes (or
+   filesystems that can't say) are left dense */
+int lextents(LAYOUT *l, const char *path)
+{
+	EXTENT *e;
+	size_t n, cap;
+	off_t data, hole;
+	void *p;
+	int fd, err;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0) return -1;
+
+	e = NULL;
+	n = cap = 0;
+	err = 0;
+	for (hole = 0; hole < (off_t)l->len; ) {
+		data = lseek(fd, hole, SEEK_DATA);
+		if (data < 0) { /* ENXIO: only a hole from here on */
+			err = errno == ENXIO ? 0 : errno;
+			break;
+		}
+		hole = lseek(fd, data, SEEK_HOLE);
+		if (hole < 0) hole = l->len;
+		if (n == cap) {
+			cap = cap ? cap * 2 : 64;
+			if (!(p = realloc(e, cap * sizeof(EXTENT)))) {
+				free(e);
+				close(fd);
+				return -1;
+			}
+			e = p;
+		}
+		e[n].start = data;
+		e[n].end   = min((size_t)hole, l->len);
+		n++;
+	}
+	close(fd);
+
+	if (err || (n == 1 && e[0].start == 0 && e[0].end == l->len)) {
+		free(e); /* dense, or SEEK_DATA isn't supported */
+		return 0;
+	}
+	if (!e && !(e = malloc(sizeof(EXTENT)))) return -1; /* all hole */
+	l->extents  = e;
+	l->nextents = n;
+	return 0;
+}
+
+/* A hole spanning two or more whole rows is drawn as a single marker
+   row.  If `at` is under one, that row covers [*a, *b). */
+int lhole(LAYOUT *l, size_t at, size_t *a, size_t *b)
+{
+	size_t lo, hi, mid, hs, he;
+
+	if (!l->extents) return 0;
+	for (lo = 0, hi = l->nextents; lo < hi; ) {
+		mid = (lo + hi) / 2;
+		if (l->extents[mid].end <= at) lo = mid + 1;
+		else                           hi = mid;
+	}
+	if (lo < l->nextents && l->extents[lo].start <= at) return 0; /* data */
+
+	hs = lo ? l->extents[lo - 1].end : 0;
+	he = lo < l->nextents ? l->extents[lo].start : l->len;
+	hs = (hs + l->width - 1) / l->width * l->width; /* whole rows only */
+	he = he / l->width * l->width;
+	if (he < hs + 2 * l->width || at < hs || at >= he) return 0;
+	*a = hs;
+	*b = he;
+	return 1;
+}
+
+/* where the row holding `at` starts, and where the rows either side
+   of the one at `row` start */
+size_t lrow(LAYOUT *l, size_t at)
+{
+	size_t a, b;
+
+	return lhole(l, at, &a, &b) ? a : at - at % l->width;
+}
+
+size_t lrow_next(LAYOUT *l, size_t row)
+{
+	size_t a, b;
+
+	return lhole(l, row, &a, &b) ? b : row + l->width;
+}
+
+size_t lrow_prev(LAYOUT *l, size_t row)
+{
+	return row ? lrow(l, row - 1) : 0;
+}
+
+/* how many rows down from `top` the row at `row` is drawn, or -1 if
+   that is off the screen */
+int lrows_to(LAYOUT *l, size_t top, size_t row)
+{
+	int y;
+
+	for (y = 0; y < l->main_height - 1 && top < l->len; y++) {
+		if (top == row) return y;
+		top = lrow_next(l, top);
+	}
+	return -1;
+}
+
+void lpin(LAYOUT *l, size_t off, size_t len)
+{
+	if (l->src) src_pin(l->src, off, len);
+}
+
+void lunpin(LAYOUT *l, size_t off, size_t len)
+{
+	if (l->src) src_unpin(l->src, off, len);
+}
+
+/* prefetching {{{ */
+/* Plain files are read through the mapping, so every page not yet in
+   the page cache stalls the UI on a fault (slow on NFS, or on a cold
+   cache).  While the view keeps moving one way, the pages ahead of it
+   are asked for early: with MADV_WILLNEED, or (PF_THREAD) by a thread
+   that touches them.  A jump elsewhere counts as random access, and
+   stops all that again.  Each page of a new view (and of each window
+   a search reads) is counted as a hit if it was already resident, or
+   as a miss if it wasn't. */
+#define PF_STREAK 2  /* moves one way before that counts as sequential */
+#define PF_AHEAD  8  /* most screens to read ahead */
+
+static size_t pagesize(void)
+{
+	static size_t n;
+
+	if (!n) n = sysconf(_SC_PAGESIZE);
+	return n;
+}
+
+/* clamps [off, off + len) to the file, and widens it to whole pages */
+static int pf_range(LAYOUT *l, size_t off, size_t len, size_t *a, size_t *n)
+{
+	if (l->src || off >= l->len || !len) return 0;
+	len = min(len, l->len - off);
+	*a  = off & ~(pagesize() - 1);
+	*n  = off + len - *a;
+	return 1;
+}
+
+void pf_advise(LAYOUT *l, size_t off, size_t len, int advice)
+{
+	size_t a, n;
+
+	if (l->pf.mode == PF_OFF || !pf_range(l, off, len, &a, &n)) return;
+	madvise(l->data + a, n, advice);
+}
+
+/* counts the pages of [off, off + len) that are resident already */
+void pf_count(LAYOUT *l, size_t off, size_t len)
+{
+	unsigned char vec[256];
+	size_t a, n, i, k;
+
+	if (!pf_range(l, off, len, &a, &n)) return;
+	for (; n; a += k * pagesize(), n -= min(n, k * pagesize())) {
+		k = min((n + pagesize() - 1) / pagesize(), sizeof(vec));
+		if (mincore(l->data + a, min(n, k * pagesize()), vec) != 0) return;
+		for (i = 0; i < k; i++) {
+			if (vec[i] & 1) l->pf.hits++;
+			else            l->pf.misses++;
+		}
+	}
+}
+
+static void *pf_run(void *_)
+{
+	PREFETCH *pf;
+	size_t at, end, gen;
+	volatile uint8_t sink;
+
+	pf = (PREFETCH *)_;
+	pthread_mutex_lock(&pf->lock);
+	for (;;) {
+		while (pf->gen == pf->done && !pf->stop) pthread_cond_wait(&pf->cv, &pf->lock);
+		if (pf->stop) break;
+		gen = pf->gen;
+		at  = pf->off;
+		end = pf->off + pf->len;
+		pthread_mutex_unlock(&pf->lock);
+
+		/* one read per page faults it in; a newer request wins */
+		for (; at < end && pf->gen == gen; at += pagesize()) {
+			sink = pf->data[at];
+		}
+		(void)sink;
+
+		pthread_mutex_lock(&pf->lock);
+		pf->done = gen;
+	}
+	pthread_mutex_unlock(&pf->lock);
+	return NULL;
+}
+
+/* reads [off, off + len) ahead of the view */
+void pf_ahead(LAYOUT *l, size_t off, size_t len)
+{
+	PREFETCH *pf;
+	size_t a, n;
+
+	pf = &l->pf;
+	if (pf->mode != PF_THREAD) {
+		pf_advise(l, off, len, MADV_WILLNEED);
+		return;
+	}
+	if (!pf_range(l, off, len, &a, &n)) return;
+	if (!pf->running) {
+		pthread_mutex_init(&pf->lock, NULL);
+		pthread_cond_init(&pf->cv, NULL);
+		pf->data = l->data;
+		if (pthread_create(&pf->tid, NULL, pf_run, pf) != 0) {
+			pf->mode = PF_HINT;
+			pf_advise(l, off, len, MADV_WILLNEED);
+			return;
+		}
+		pf->running = 1;
+	}
+	pthread_mutex_lock(&pf->lock);
+	pf->off = a;
+	pf->len = n;
+	pf->gen++;
+	pthread_cond_signal(&pf->cv);
+	pthread_mutex_unlock(&pf->lock);
+}
+
+/* notes where the view has moved to, and reads ahead of it if it
+   keeps moving the same way */
+void pf_view(LAYOUT *l)
+{
+	PREFETCH *pf;
+	size_t screen;
+	int dir;
+
+	pf = &l->pf;
+	if (l->src || (pf->seen && l->offset == pf->last)) return;
+
+	screen = l->width * l->main_height;
+	pf_count(l, l->offset, screen);
+	if (pf->mode == PF_OFF) {
+		pf->seen = 1;
+		pf->last = l->offset;
+		return;
+	}
+
+	dir = !pf->seen                         ? 0
+	    : l->offset > pf->last && l->offset - pf->last <= 2 * screen ?  1
+	    : l->offset < pf->last && pf->last - l->offset <= 2 * screen ? -1 : 0;
+	if (dir && dir == pf->dir) {
+		pf->streak++;
+	} else {
+		if (pf->streak >= PF_STREAK) { /* was sequential; not any more */
+			pf_advise(l, pf->last > PF_AHEAD * screen ? pf->last - PF_AHEAD * screen : 0,
+				(2 * PF_AHEAD + 1) * screen, MADV_NORMAL);
+		}
+		pf->streak = dir ? 1 : 0;
+	}
+	pf->dir  = dir;
+	pf->last = l->offset;
+	pf->seen = 1;
+
+	if (pf->streak < PF_STREAK) return;
+	/* read further ahead, the longer it goes on */
+	if (dir > 0) {
+		pf_ahead(l, l->offset + screen, min(pf->streak, PF_AHEAD) * screen);
+	} else if (l->offset) {
+		pf_ahead(l, l->offset > min(pf->streak, PF_AHEAD) * screen ? l->offset - min(pf->streak, PF_AHEAD) * screen : 0,
+			min(l->offset, min(pf->streak, PF_AHEAD) * screen));
+	}
+}
+/* }}} */
+/* keeps the screen (plus lookahead, for the status bar) pinned */
+#define VIEW_SLOP 4096
+void lview(LAYOUT *l)
+{
+	size_t len;
+
+	if (!l->src) {
+		pf_view(l);
+		return;
+	}
+	l->len = l->src->len;
+
+	len = l->width * l->main_height + VIEW_SLOP;
+	src_pin(l->src, l->offset, len);
+	src_unpin(l->src, l->vpin_off, l->vpin_len);
+	l->vpin_off = l->offset;
+	l->vpin_len = len;
+}
+/* }}} */
+/* gzip images {{{ */
+/* Random access into gzip images, in the style of zlib's zran.c: as
+   the (background) indexer inflates the image, it remembers an access
+   point every GZ_SPAN octets -- the deflate bit position, plus the
+   32k of history needed to resume there.  Filling a chunk inflates
+   from the nearest access point before it.  Once complete, the index
+   is persisted to the cache directory, and mapped back in (windows
+   and all) the next time the image is opened. */
+#define GZ_SPAN   (8 << 20)
+#define GZ_WINDOW 32768
+#define GZ_MAGIC  "VEXGZI1"
+
+typedef struct {
+	uint64_t out;    /* uncompressed offset */
+	uint64_t in;     /* compressed offset of the first full byte */
+	int64_t  bits;   /* bits from the byte before `in`, or -1 at a member start */
+	uint8_t  window[GZ_WINDOW];
+} GZPOINT;
+
+typedef struct {
+	char     magic[8];
+	uint64_t size;   /* compressed size ... */
+	uint64_t mtime;  /* ... and mtime, for validation */
+	uint64_t len;    /* uncompressed size */
+	uint64_t npoints;
+} GZHEADER;
+
+typedef struct {
+	const uint8_t *in;  /* the compressed image, mapped */
+	size_t inlen;
+	struct stat st;
+
+	GZPOINT *points;
+	size_t npoints, cap;
+	void *mapped;       /* persisted index, if we loaded one */
+	size_t maplen;
+} GZ;
+
+static int gz_feed(z_stream *z, const GZ *gz, size_t at)
+{
+	size_t n;
+
+	if (at >= gz->inlen) return 0;
+	n = min(gz->inlen - at, 1UL << 30);
+	z->next_in  = (uint8_t *)gz->in + at;
+	z->avail_in = n;
+	return 1;
+}
+
+static int gz_addpoint(SOURCE *s, GZ *gz, int bits, uint64_t in, uint64_t out,
+                       unsigned left, const uint8_t *window)
+{
+	GZPOINT *p;
+
+	pthread_mutex_lock(&s->lock);
+	if (gz->npoints == gz->cap) {
+		p = realloc(gz->points, (gz->cap ? gz->cap * 2 : 64) * sizeof(GZPOINT));
+		if (!p) {
+			pthread_mutex_unlock(&s->lock);
+			return -1;
+		}
+		gz->points = p;
+		gz->cap = gz->cap ? gz->cap * 2 : 64;
+	}
+	p = &gz->points[gz->npoints];
+	p->out  = out;
+	p->in   = in;
+	p->bits = bits;
+	if (left) memcpy(p->window, window + GZ_WINDOW - left, left);
+	if (left < GZ_WINDOW) memcpy(p->window + left, window, GZ_WINDOW - left);
+	gz->npoints++;
+	pthread_mutex_unlock(&s->lock);
+	return 0;
+}
+
+static void gz_persist(SOURCE *s, GZ *gz)
+{
+	GZHEADER h;
+	char path[8192], tmp[8200];
+	FILE *io;
+
+	if (cachepath(path, sizeof(path), &gz->st, "gzi") != 0) return;
+	snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, GZ_MAGIC, sizeof(h.magic));
+	h.size    = gz->st.st_size;
+	h.mtime   = gz->st.st_mtime;
+	h.len     = s->len;
+	h.npoints = gz->npoints;
+
+	io = fopen(tmp, "w");
+	if (!io) return;
+	if (fwrite(&h, sizeof(h), 1, io) != 1
+	 || fwrite(gz->points, sizeof(GZPOINT), gz->npoints, io) != gz->npoints) {
+		fclose(io);
+		unlink(tmp);
+		return;
+	}
+	if (fclose(io) == 0) rename(tmp, path);
+	else unlink(tmp);
+}
+
+static int gz_load(SOURCE *s, GZ *gz)
+{
+	GZHEADER *h;
+	char path[8192];
+	struct stat st;
+	void *addr;
+	int fd;
+
+	if (cachepath(path, sizeof(path), &gz->st, "gzi") != 0) return -1;
+	fd = open(path, O_RDONLY);
+	if (fd < 0) return -1;
+	if (fstat(fd, &st) != 0 || st.st_size < sizeof(GZHEADER)) {
+		close(fd);
+		return -1;
+	}
+	addr = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (addr == MAP_FAILED) return -1;
+
+	h = (GZHEADER *)addr;
+	if (memcmp(h->magic, GZ_MAGIC, sizeof(h->magic)) != 0
+	 || h->size != gz->st.st_size || h->mtime != gz->st.st_mtime
+	 || st.st_size != sizeof(GZHEADER) + h->npoints * sizeof(GZPOINT)) {
+		munmap(addr, st.st_size);
+		return -1;
+	}
+
+	if (src_grow(s, h->len) != 0) { /* before gz_index() could see it */
+		munmap(addr, st.st_size);
+		return -1;
+	}
+	gz->mapped  = addr;
+	gz->maplen  = st.st_size;
+	gz->points  = (GZPOINT *)(h + 1);
+	gz->npoints = h->npoints;
+	s->complete = 1;
+	return 0;
+}
+
+/* the background indexer; see build_index() in zlib's zran.c */
+static void *gz_index(void *_)
+{
+	SOURCE *s;
+	GZ *gz;
+	z_stream z;
+	uint8_t window[GZ_WINDOW];
+	uint64_t totin, totout, last;
+	int rc;
+
+	rc = Z_OK;
+	s  = (SOURCE *)_;
+	gz = (GZ *)s->priv;
+	s->job.total = gz->inlen;
+
+	memset(&z, 0, sizeof(z));
+	if (inflateInit2(&z, 47) != Z_OK) goto done;
+
+	totin = totout = last = 0;
+	gz_feed(&z, gz, 0);
+	z.avail_out = 0;
+	do {
+		if (z.avail_in == 0 && !gz_feed(&z, gz, totin)) break;
+		if (z.avail_out == 0) {
+			z.avail_out = GZ_WINDOW;
+			z.next_out  = window;
+		}
+
+		totin  += z.avail_in;
+		totout += z.avail_out;
+		rc = inflate(&z, Z_BLOCK);
+		totin  -= z.avail_in;
+		totout -= z.avail_out;
+		if (rc == Z_NEED_DICT || rc == Z_MEM_ERROR || rc == Z_DATA_ERROR) break;
+
+		if (rc == Z_STREAM_END) { /* on to the next member, if any */
+			if (z.avail_in == 0 && !gz_feed(&z, gz, totin)) break;
+			if (z.next_in[0] != 0x1f) break; /* trailing garbage */
+			inflateReset(&z);
+			if (gz_addpoint(s, gz, -1, totin, totout, 0, window) != 0) break;
+			last = totout;
+			rc = Z_OK;
+
+		} else if ((z.data_type & 128) && !(z.data_type & 64)
+		        && (totout == 0 || totout - last > GZ_SPAN)) {
+			if (gz_addpoint(s, gz, z.data_type & 7, totin, totout, z.avail_out, window) != 0) break;
+			last = totout;
+		}
+
+		if (totout - s->len >= SRC_CHUNK) {
+			pthread_mutex_lock(&s->lock);
+			src_grow(s, totout);
+			pthread_mutex_unlock(&s->lock);
+		}
+		s->job.progress = totin;
+	} while (!s->job.cancel && totout < s->reserved);
+	inflateEnd(&z);
+
+	pthread_mutex_lock(&s->lock);
+	src_grow(s, totout);
+	pthread_mutex_unlock(&s->lock);
+	if (!s->job.cancel && (rc == Z_STREAM_END || rc == Z_OK)) {
+		s->complete = 1;
+		gz_persist(s, gz);
+	}
+
+done:
+	s->job.done = 1;
+	return NULL;
+}
+
+/* inflate [off, off+len) into place; see extract() in zlib's zran.c */
+static int gz_fill(SOURCE *s, size_t off, size_t len)
+{
+	GZ *gz;
+	GZPOINT *p;
+	z_stream z;
+	uint8_t discard[GZ_WINDOW];
+	uint64_t at, in;
+	size_t lo, hi, mid, n;
+	int rc;
+
+	gz = (GZ *)s->priv;
+	if (gz->npoints == 0) return -1;
+
+	lo = 0; hi = gz->npoints;
+	while (hi - lo > 1) {
+		mid = (lo + hi) / 2;
+		if (gz->points[mid].out <= off) lo = mid;
+		else hi = mid;
+	}
+
+	rc = Z_OK;
+	for (p = &gz->points[lo]; p < gz->points + gz->npoints && off < s->len && len; p++) {
+		memset(&z, 0, sizeof(z));
+		if (p->bits < 0) {
+			if (inflateInit2(&z, 47) != Z_OK) return -1;
+			gz_feed(&z, gz, p->in);
+		} else {
+			if (inflateInit2(&z, -15) != Z_OK) return -1;
+			if (p->bits) inflatePrime(&z, p->bits, gz->in[p->in - 1] >> (8 - p->bits));
+			inflateSetDictionary(&z, p->window, GZ_WINDOW);
+			gz_feed(&z, gz, p->in);
+		}
+
+		in = p->in;
+		at = p->out;
+		while (len) {
+			if (at < off) { /* skip ahead to the good part */
+				z.next_out  = discard;
+				z.avail_out = min(off - at, sizeof(discard));
+			} else {
+				z.next_out  = s->base + at;
+				z.avail_out = min(len, 1UL << 30);
+			}
+			n = z.avail_out;
+
+			in += z.avail_in;
+			rc = inflate(&z, Z_NO_FLUSH);
+			in -= z.avail_in;
+			n -= z.avail_out;
+			if (at >= off) {
+				off += n;
+				len -= n;
+			}
+			at += n;
+
+			if (rc == Z_STREAM_END) break;
+			if (rc != Z_OK && rc != Z_BUF_ERROR) {
+				inflateEnd(&z);
+				return -1;
+			}
+			if (z.avail_in == 0 && !gz_feed(&z, gz, in)) break;
+		}
+		inflateEnd(&z);
+
+		/* a member ended short of the range; the next access
+		   point picks up at the start of the next member */
+		if (rc != Z_STREAM_END) break;
+		while (p + 1 < gz->points + gz->npoints && p[1].out < at) p++;
+	}
+	return len && off < s->len ? -1 : 0;
+}
+
+SOURCE* gz_open(const char *path, const uint8_t *in, size_t inlen)
+{
+	SOURCE *s;
+	GZ *gz;
+
+	gz = calloc(1, sizeof(GZ));
+	if (!gz || stat(path, &gz->st) != 0) {
+		free(gz);
+		return NULL;
+	}
+	gz->in    = in;
+	gz->inlen = inlen;
+
+	/* deflate can't do better than 1032:1 */
+	s = src_new("gzip", (uint64_t)inlen * 1032 + SRC_CHUNK);
+	if (!s) {
+		free(gz);
+		return NULL;
+	}
+	s->priv      = gz;
+	s->fill      = gz_fill;
+	s->readahead = GZ_SPAN / SRC_CHUNK;
+
+	if (gz_load(s, gz) != 0) {
+		if (job_start(&s->job, gz_index, s) != 0) { /* so, not decompressed */
+			src_discard(s);
+			free(gz);
+			return NULL;
+		}
+		s->indexing = 1;
+	}
+	return s;
+}
+/* }}} */
+/* xz images {{{ */
+/* xz files carry their own index of (independently compressed)
+   blocks, so random access is a matter of finding the right block,
+   and decoding from its start.  Images compressed with threaded xz
+   (-T) have plenty of small blocks; single-block images still work,
+   but every fill decodes from the start of the file. */
+typedef struct {
+	const uint8_t *in;
+	size_t inlen;
+	lzma_index *index;
+} XZ;
+
+static int xz_fill(SOURCE *s, size_t off, size_t len)
+{
+	XZ *xz;
+	lzma_index_iter it;
+	lzma_filter filters[LZMA_FILTERS_MAX + 1];
+	lzma_block block;
+	lzma_stream z = LZMA_STREAM_INIT;
+	uint8_t discard[65536];
+	uint64_t at;
+	size_t n;
+	const uint8_t *hdr;
+	lzma_ret rc;
+	int i;
+
+	xz = (XZ *)s->priv;
+	lzma_index_iter_init(&it, xz->index);
+	if (lzma_index_iter_locate(&it, off)) return -1;
+
+	do {
+		hdr = xz->in + it.block.compressed_file_offset;
+		memset(&block, 0, sizeof(block));
+		block.version     = 0;
+		block.check       = it.stream.flags->check;
+		block.filters     = filters;
+		block.header_size = lzma_block_header_size_decode(hdr[0]);
+		if (lzma_block_header_decode(&block, NULL, hdr) != LZMA_OK) return -1;
+		if (lzma_block_compressed_size(&block, it.block.unpadded_size) != LZMA_OK
+		 || lzma_block_decoder(&z, &block) != LZMA_OK) {
+			for (i = 0; filters[i].id != LZMA_VLI_UNKNOWN; i++) free(filters[i].options);
+			return -1;
+		}
+		for (i = 0; filters[i].id != LZMA_VLI_UNKNOWN; i++) free(filters[i].options);
+
+		z.next_in  = hdr + block.header_size;
+		z.avail_in = it.block.total_size - block.header_size;
+		at = it.block.uncompressed_file_offset;
+		do {
+			if (at < off) {
+				z.next_out  = discard;
+				z.avail_out = min(off - at, sizeof(discard));
+			} else {
+				z.next_out  = s->base + at;
+				z.avail_out = len;
+			}
+			n = z.avail_out;
+			rc = lzma_code(&z, LZMA_RUN);
+			n -= z.avail_out;
+			if (at >= off) {
+				off += n;
+				len -= n;
+			}
+			at += n;
+		} while (rc == LZMA_OK && len);
+		lzma_end(&z);
+
+		if (rc != LZMA_OK && rc != LZMA_STREAM_END) return -1;
+	} while (len && !lzma_index_iter_next(&it, LZMA_INDEX_ITER_BLOCK));
+
+	return len ? -1 : 0;
+}
+
+SOURCE* xz_open(const uint8_t *in, size_t inlen)
+{
+	SOURCE *s;
+	XZ *xz;
+	lzma_stream z = LZMA_STREAM_INIT;
+	lzma_index *index;
+	lzma_ret rc;
+
+	/* the index lives at the end of the file, so the decoder
+	   will ask to seek; everything's mapped, so that's easy */
+	index = NULL;
+	if (lzma_file_info_decoder(&z, &index, UINT64_MAX, inlen) != LZMA_OK) return NULL;
+	z.next_in  = in;
+	z.avail_in = inlen;
+	do {
+		rc = lzma_code(&z, LZMA_RUN);
+		if (rc == LZMA_SEEK_NEEDED) {
+			z.next_in  = in + z.seek_pos;
+			z.avail_in = inlen - z.seek_pos;
+			rc = LZMA_OK;
+		}
+	} while (rc == LZMA_OK);
+	lzma_end(&z);
+	if (rc != LZMA_STREAM_END) {
+		if (index) lzma_index_end(index, NULL);
+		return NULL;
+	}
+
+	xz = calloc(1, sizeof(XZ));
+	s = src_new("xz", lzma_index_uncompressed_size(index));
+	if (!xz || !s || src_grow(s, lzma_index_uncompressed_size(index)) != 0) {
+		if (s) src_discard(s);
+		free(xz);
+		lzma_index_end(index, NULL);
+		return NULL;
+	}
+	xz->in    = in;
+	xz->inlen = inlen;
+	xz->index = index;
+
+	s->priv      = xz;
+	s->fill      = xz_fill;
+	s->readahead = 8;
+	s->complete  = 1;
+	return s;
+}
+/* }}} */
+/* budgeted files {{{ */
+/* With a memory budget, files bigger than it aren't mapped whole.
+   They're read (pread) into a source instead, just like a decoded
+   image, so the clock keeps only the chunks in use resident.  What
+   gets read is dropped from the page cache again right away: a pass
+   over a huge file shouldn't push everybody else's pages out. */
+typedef struct {
+	int fd;
+} FILESRC;
+
+static int file_fill(SOURCE *s, size_t off, size_t len)
+{
+	FILESRC *f;
+	ssize_t n;
+	size_t at;
+
+	f = (FILESRC *)s->priv;
+	for (at = 0; at < len; at += n) {
+		n = pread(f->fd, s->base + off + at, len - at, off + at);
+		if (n < 0 && errno == EINTR) n = 0;
+		else if (n <= 0) break;
+	}
+	posix_fadvise(f->fd, off, at, POSIX_FADV_DONTNEED);
+	return at == len ? 0 : -1;
+}
+
+SOURCE* file_open(int fd, size_t len)
+{
+	SOURCE *s;
+	FILESRC *f;
+
+	if (len > SRC_RESERVE) return NULL;
+	f = calloc(1, sizeof(FILESRC));
+	s = src_new("file", len);
+	if (!f || !s || src_grow(s, len) != 0) { /* fd stays the caller's */
+		free(f);
+		if (s) src_discard(s);
+		return NULL;
+	}
+	f->fd = fd;
+
+	s->priv      = f;
+	s->fill      = file_fill;
+	s->readahead = 4;
+	s->complete  = 1;
+	return s;
+}
+/* }}} */
+/* process images {{{ */
+/* `vex -p PID` shows the readable mappings of a running process, back
+   to back (the unmapped gaps between them, and mappings that can't be
+   read, are left out), as a source filled from the process itself:
+   process_vm_readv where allowed, or else pread on /proc/PID/mem.
+   Pages that won't read (guard pages, [vvar], etc.) come out as
+   zeros.  Once read, chunks are kept until evicted; Ctrl-L reads
+   the ones on screen again. */
+typedef struct {
+	uint64_t addr, end;  /* [addr, end) in the process */
+	uint64_t off;        /* where it starts in the image */
+	char perms[5];
+	char *name;          /* the file mapped (basename), [heap], etc. */
+} PMAP;
+
+typedef struct {
+	pid_t pid;
+	int mem;             /* /proc/PID/mem */
+	int vm;              /* does process_vm_readv work? */
+	PMAP *maps;          /* by address (and so, by offset) */
+	size_t n;
+	size_t dropped;      /* mappings that didn't fit in SRC_RESERVE */
+} PROC;
+
+static void proc_read(PROC *p, uint8_t *dst, uint64_t addr, size_t n)
+{
+	struct iovec local, remote;
+	ssize_t got;
+	size_t at, step;
+
+	at = 0;
+	if (p->vm) {
+		local.iov_base  = dst;
+		local.iov_len   = n;
+		remote.iov_base = (void *)(uintptr_t)addr;
+		remote.iov_len  = n;
+		got = process_vm_readv(p->pid, &local, 1, &remote, 1, 0);
+		if (got < 0 && (errno == ENOSYS || errno == EPERM)) p->vm = 0;
+		if (got > 0) at = got;
+	}
+	/* the rest, a page at a time, so one bad page costs only itself */
+	for (; at < n; at += step) {
+		step = min(n - at, pagesize() - (addr + at) % pagesize());
+		if (pread(p->mem, dst + at, step, addr + at) != step) {
+			memset(dst + at, 0, step);
+		}
+	}
+}
+
+static int proc_fill(SOURCE *s, size_t off, size_t len)
+{
+	PROC *p;
+	size_t lo, hi, mid, n;
+
+	p = (PROC *)s->priv;
+	lo = 0; hi = p->n;
+	while (hi - lo > 1) {
+		mid = (lo + hi) / 2;
+		if (p->maps[mid].off <= off) lo = mid;
+		else hi = mid;
+	}
+	for (; lo < p->n && len; lo++) {
+		n = min(len, p->maps[lo].off + (p->maps[lo].end - p->maps[lo].addr) - off);
+		proc_read(p, s->base + off, p->maps[lo].addr + (off - p->maps[lo].off), n);
+		off += n;
+		len -= n;
+	}
+	return 0;
+}
+
+SOURCE* proc_open(pid_t pid)
+{
+	SOURCE *s;
+	PROC *p;
+	PMAP *m;
+	FILE *io;
+	char path[64], line[4096], name[4096], *base;
+	unsigned long long addr, end;
+	uint64_t total;
+	size_t cap, i;
+
+	snprintf(path, sizeof(path), "/proc/%d/maps", (int)pid);
+	io = fopen(path, "r");
+	if (!io) return NULL;
+	p = calloc(1, sizeof(PROC));
+	if (!p) {
+		fclose(io);
+		return NULL;
+	}
+	p->pid = pid;
+	p->vm  = 1;
+	p->mem = -1;
+
+	total = cap = 0;
+	while (fgets(line, sizeof(line), io)) {
+		name[0] = '\0';
+		if (sscanf(line, "%llx-%llx %4s %*x %*s %*u %4095[^\n]", &addr, &end, path, name) < 3) continue;
+		if (path[0] != 'r' || end <= addr) continue;
+		if (total + (end - addr) > SRC_RESERVE) { /* see proc_dropped() */
+			p->dropped++;
+			continue;
+		}
+
+		if (p->n == cap) {
+			cap = cap ? cap * 2 : 64;
+			m = realloc(p->maps, cap * sizeof(PMAP));
+			if (!m) goto fail;
+			p->maps = m;
+		}
+		m = &p->maps[p->n];
+		m->addr = addr;
+		m->end  = end;
+		m->off  = total;
+		memcpy(m->perms, path, 5);
+		base = strrchr(name, '/');
+		m->name = strdup(base ? base + 1 : name[0] ? name : "[anon]");
+		if (!m->name) goto fail;
+		p->n++;
+		total += end - addr;
+	}
+	fclose(io);
+	io = NULL;
+
+	errno = 0;
+	snprintf(path, sizeof(path), "/proc/%d/mem", (int)pid);
+	p->mem = open(path, O_RDONLY);
+	s = p->n && p->mem >= 0 ? src_new("process", total) : NULL;
+	if (!s) goto fail;
+	s->priv      = p;
+	s->fill      = proc_fill;
+	s->readahead = 1;
+	s->complete  = 1;
+	if (src_grow(s, total) != 0) {
+		src_discard(s);
+		goto fail;
+	}
+	return s;
+
+fail:
+	if (!errno) errno = ENOENT;
+	if (io) fclose(io);
+	if (p->mem >= 0) close(p->mem);
+	for (i = 0; i < p->n; i++) {
+		free(p->maps[i].name);
+	}
+	free(p->maps);
+	free(p);
+	return NULL;
+}
+
+/* how many of the process's mappings were left out of the image */
+size_t proc_dropped(SOURCE *s)
+{
+	return ((PROC *)s->priv)->dropped;
+}
+
+/* the address in the process of image offset `off` */
+uint64_t proc_addr(SOURCE *s, size_t off)
+{
+	PROC *p;
+	size_t lo, hi, mid;
+
+	p = (PROC *)s->priv;
+	lo = 0; hi = p->n;
+	while (hi - lo > 1) {
+		mid = (lo + hi) / 2;
+		if (p->maps[mid].off <= off) lo = mid;
+		else hi = mid;
+	}
+	return p->maps[lo].addr + (off - p->maps[lo].off);
+}
+
+/* ... and the other way around; fails for addresses not in the image */
+int proc_off(SOURCE *s, uint64_t addr, size_t *off)
+{
+	PROC *p;
+	size_t lo, hi, mid;
+
+	p = (PROC *)s->priv;
+	lo = 0; hi = p->n;
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (p->maps[mid].end <= addr) lo = mid + 1;
+		else hi = mid;
+	}
+	if (lo == p->n || p->maps[lo].addr > addr) return -1;
+	*off = p->maps[lo].off + (addr - p->maps[lo].addr);
+	return 0;
+}
+
+
+/* the address (in a process) or offset (in a file) of `off` */
+uint64_t laddr(LAYOUT *l, size_t off)
+{
+	return l->src && l->src->fill == proc_fill ? proc_addr(l->src, off) : off;
+}
+/* }}} */
+/* structure index {{{ */
+/* Executables and core dumps (ELF, PE and Mach-O) get an index of
+   their segments and sections, as regions sorted by start offset, with
+   a running maximum of end offsets -- an implicit interval tree -- so
+   that finding the regions around an offset doesn't mean looking at
+   all of them.  Symbols (and section names) are hashed, by name, to
+   their file offsets.  Nothing is parsed until something asks for the
+   index, and then it is built in the background. */
+#define IN(ix,off,n) ((off) <= (ix)->len && (n) <= (ix)->len - (off))
+
+static size_t ix_name(INDEX *ix, const void *s, size_t max)
+{
+	size_t n, at;
+	char *p;
+
+	n = strnlen((const char *)s, max);
+	if (ix->poollen + n + 1 > ix->poolcap) {
+		ix->poolcap = max(ix->poolcap * 2, ix->poollen + n + 1 + 4096);
+		p = realloc(ix->pool, ix->poolcap);
+		if (!p) return 0;
+		ix->pool = p;
+	}
+	at = ix->poollen;
+	memcpy(ix->pool + at, s, n);
+	ix->pool[at + n] = '\0';
+	ix->poollen += n + 1;
+	return at;
+}
+
+static void ix_region(INDEX *ix, uint64_t start, uint64_t size, int kind, const void *name, size_t max)
+{
+	REGION *r;
+
+	if (size == 0 || start >= ix->len) return;
+	if (size > ix->len - start) size = ix->len - start;
+
+	if (ix->nregions == ix->regcap) {
+		r = realloc(ix->regions, (ix->regcap ? ix->regcap * 2 : 64) * sizeof(REGION));
+		if (!r) return;
+		ix->regions = r;
+		ix->regcap = ix->regcap ? ix->regcap * 2 : 64;
+	}
+	r = &ix->regions[ix->nregions++];
+	r->start = start;
+	r->end   = start + size;
+	r->kind  = kind;
+	r->name  = ix_name(ix, name, max);
+}
+
+static void ix_symbol(INDEX *ix, const void *name, size_t max, uint64_t off)
+{
+	SYMBOL *s;
+
+	if (off >= ix->len || max == 0 || !*(const char *)name) return;
+
+	if (ix->nsyms == ix->symcap) {
+		s = realloc(ix->syms, (ix->symcap ? ix->symcap * 2 : 256) * sizeof(SYMBOL));
+		if (!s) return;
+		ix->syms = s;
+		ix->symcap = ix->symcap ? ix->symcap * 2 : 256;
+	}
+	s = &ix->syms[ix->nsyms++];
+	s->offset = off;
+	s->name   = ix_name(ix, name, max);
+}
+
+/* pins ranges of a decoded source for the rest of the build */
+static void ix_pin(INDEX *ix, uint64_t off, uint64_t n)
+{
+	if (!ix->src || ix->npins == sizeof(ix->pins) / sizeof(ix->pins[0])) return;
+	src_pin(ix->src, off, n);
+	ix->pins[ix->npins][0] = off;
+	ix->pins[ix->npins][1] = n;
+	ix->npins++;
+}
+
+/* a process image's mappings (see proc_open) */
+static int proc_parse(INDEX *ix)
+{
+	PROC *p;
+	PMAP *m;
+	char name[4200];
+	size_t i;
+
+	if (!ix->src || ix->src->fill != proc_fill) return -1;
+	p = (PROC *)ix->src->priv;
+	for (i = 0; i < p->n; i++) {
+		m = &p->maps[i];
+		snprintf(name, sizeof(name), "%s %s", m->name, m->perms);
+		ix_region(ix, m->off, m->end - m->addr, R_SEGMENT, name, sizeof(name));
+		ix_symbol(ix, m->name, strlen(m->name) + 1, m->off);
+	}
+	ix->format = "process";
+	return 0;
+}
+
+#define U(off,n) peek_uint(d + (off), (n), le)
+
+static int elf_parse(INDEX *ix)
+{
+	const uint8_t *d;
+	uint64_t phoff, shoff, p, off, size, addr, value, str, sym, sec;
+	unsigned phent, phnum, shent, shnum, shstrndx, type, flags, link, etype, i, j, n, esz, shndx;
+	int le, is64;
+	char name[64];
+
+	d = ix->data;
+	ix_pin(ix, 0, 64);
+	if (ix->len < 52 || memcmp(d, "\177ELF", 4) != 0) return -1;
+	is64 = d[4] == 2;
+	le   = d[5] == 1;
+	if (is64 && ix->len < 64) return -1;
+
+	etype = U(0x10, 2);
+	if (is64) {
+		phoff = U(0x20, 8); shoff = U(0x28, 8);
+		phent = U(0x36, 2); phnum = U(0x38, 2);
+		shent = U(0x3a, 2); shnum = U(0x3c, 2); shstrndx = U(0x3e, 2);
+	} else {
+		phoff = U(0x1c, 4); shoff = U(0x20, 4);
+		phent = U(0x2a, 2); phnum = U(0x2c, 2);
+		shent = U(0x2e, 2); shnum = U(0x30, 2); shstrndx = U(0x32, 2);
+	}
+	ix->format = is64 ? "ELF64" : "ELF32";
+	ix_pin(ix, phoff, (uint64_t)phent * phnum);
+	ix_pin(ix, shoff, (uint64_t)shent * shnum);
+
+	for (i = 0; i < phnum; i++) {
+		p = phoff + (uint64_t)i * phent;
+		if (phent < (is64 ? 56 : 32) || !IN(ix, p, phent)) break;
+		type = U(p, 4);
+		if (is64) { flags = U(p +  4, 4); off = U(p + 8, 8); addr = U(p + 16, 8); size = U(p + 32, 8); }
+		else      { flags = U(p + 24, 4); off = U(p + 4, 4); addr = U(p +  8, 4); size = U(p + 16, 4); }
+
+		switch (type) {
+		case 1:          snprintf(name, sizeof(name), "LOAD");         break;
+		case 2:          snprintf(name, sizeof(name), "DYNAMIC");      break;
+		case 3:          snprintf(name, sizeof(name), "INTERP");       break;
+		case 4:          snprintf(name, sizeof(name), "NOTE");         break;
+		case 6:          snprintf(name, sizeof(name), "PHDR");         break;
+		case 7:          snprintf(name, sizeof(name), "TLS");          break;
+		case 0x6474e550: snprintf(name, sizeof(name), "GNU_EH_FRAME"); break;
+		case 0x6474e552: snprintf(name, sizeof(name), "GNU_RELRO");    break;
+		default:         snprintf(name, sizeof(name), "PT_%x", type);  break;
+		}
+		n = strlen(name);
+		snprintf(name + n, sizeof(name) - n, " %c%c%c @%lx",
+			(flags & 4) ? 'r' : '-', (flags & 2) ? 'w' : '-', (flags & 1) ? 'x' : '-', addr);
+		ix_region(ix, off, size, R_SEGMENT, name, sizeof(name));
+	}
+
+	if (shent < (is64 ? 64 : 40) || !IN(ix, shoff, (uint64_t)shent * shnum)) return 0;
+
+#define SHDR(i) (shoff + (uint64_t)(i) * shent)
+#define SH_TYPE(i)   U(SHDR(i) + 4, 4)
+#define SH_ADDR(i)   (is64 ? U(SHDR(i) + 16, 8) : U(SHDR(i) + 12, 4))
+#define SH_OFFSET(i) (is64 ? U(SHDR(i) + 24, 8) : U(SHDR(i) + 16, 4))
+#define SH_SIZE(i)   (is64 ? U(SHDR(i) + 32, 8) : U(SHDR(i) + 20, 4))
+#define SH_LINK(i)   (is64 ? U(SHDR(i) + 40, 4) : U(SHDR(i) + 24, 4))
+
+	str = shstrndx < shnum ? SH_OFFSET(shstrndx) : ix->len;
+	if (shstrndx < shnum) ix_pin(ix, str, SH_SIZE(shstrndx));
+	for (i = 0; i < shnum; i++) {
+		if (SH_TYPE(i) == 8) continue; /* SHT_NOBITS */
+		off = str + U(SHDR(i), 4);
+		if (!IN(ix, off, 1)) continue;
+		ix_region(ix, SH_OFFSET(i), SH_SIZE(i), R_SECTION, d + off, ix->len - off);
+		ix_symbol(ix, d + off, ix->len - off, SH_OFFSET(i));
+	}
+
+	esz = is64 ? 24 : 16;
+	for (i = 0; i < shnum && !ix->job.cancel; i++) {
+		type = SH_TYPE(i);
+		if (type != 2 && type != 11) continue; /* SHT_SYMTAB, SHT_DYNSYM */
+		link = SH_LINK(i);
+		if (link >= shnum) continue;
+
+		sym  = SH_OFFSET(i);
+		size = SH_SIZE(i);
+		str  = SH_OFFSET(link);
+		if (!IN(ix, sym, size)) continue;
+		ix_pin(ix, sym, size);
+		ix_pin(ix, str, SH_SIZE(link));
+
+		n = size / esz;
+		ix->job.total += n;
+		for (j = 0; j < n; j++, sym += esz) {
+			if (is64) { shndx = U(sym + 6, 2);  value = U(sym + 8, 8); }
+			else      { shndx = U(sym + 14, 2); value = U(sym + 4, 4); }
+			if (shndx == 0 || shndx >= shnum || SH_TYPE(shndx) == 8) continue;
+
+			sec = SH_OFFSET(shndx);
+			off = etype == 1 ? sec + value            /* ET_REL: section-relative */
+			                 : sec + (value - SH_ADDR(shndx));
+			addr = str + U(sym, 4);
+			if (IN(ix, addr, 1)) ix_symbol(ix, d + addr, ix->len - addr, off);
+			if ((j & 0xffff) == 0) ix->job.progress += min(n - j, 0x10000);
+		}
+	}
+#undef SHDR
+#undef SH_TYPE
+#undef SH_ADDR
+#undef SH_OFFSET
+#undef SH_SIZE
+#undef SH_LINK
+	return 0;
+}
+
+static int pe_parse(INDEX *ix)
+{
+	const uint8_t *d;
+	uint64_t pe, opt, sh, exp, names, ords, funcs, off, nsec, nnames, i, j, k, rva, ndirs;
+	uint64_t vaddr[96], vsize[96], raw[96];
+	int le;
+	char name[9];
+
+	d  = ix->data;
+	le = 1;
+	ix_pin(ix, 0, 4096);
+	if (ix->len < 0x40 || d[0] != 'M' || d[1] != 'Z') return -1;
+	pe = U(0x3c, 4);
+	if (!IN(ix, pe, 24) || memcmp(d + pe, "PE\0\0", 4) != 0) return -1;
+
+	nsec = U(pe + 6, 2);
+	opt  = pe + 24;
+	sh   = opt + U(pe + 20, 2);
+	if (!IN(ix, opt, 2)) return -1;
+	switch (U(opt, 2)) {
+	case 0x10b: ix->format = "PE32";  ndirs = opt + 92;  exp = opt + 96;  break;
+	case 0x20b: ix->format = "PE32+"; ndirs = opt + 108; exp = opt + 112; break;
+	default: return -1;
+	}
+	ix_pin(ix, sh, nsec * 40);
+
+	if (IN(ix, opt + 60, 4)) ix_region(ix, 0, U(opt + 60, 4), R_SEGMENT, "headers", 8);
+	for (i = 0; i < nsec && i < 96 && IN(ix, sh + i * 40, 40); i++) {
+		memcpy(name, d + sh + i * 40, 8);
+		name[8] = '\0';
+		vsize[i] = U(sh + i * 40 +  8, 4);
+		vaddr[i] = U(sh + i * 40 + 12, 4);
+		raw[i]   = U(sh + i * 40 + 20, 4);
+		ix_region(ix, raw[i], U(sh + i * 40 + 16, 4), R_SECTION, name, sizeof(name));
+		ix_symbol(ix, name, sizeof(name), raw[i]);
+	}
+	nsec = i;
+
+	/* exported symbols, by name */
+#define RVA2OFF(r, out) do { \
+	(out) = ix->len; \
+	for (k = 0; k < nsec; k++) { \
+		if ((r) >= vaddr[k] && (r) < vaddr[k] + vsize[k]) { (out) = raw[k] + (r) - vaddr[k]; break; } \
+	} \
+} while (0)
+
+	if (!IN(ix, ndirs, 4) || U(ndirs, 4) < 1 || !IN(ix, exp, 8)) return 0;
+	rva = U(exp, 4);
+	RVA2OFF(rva, off);
+	if (!IN(ix, off, 40)) return 0;
+	ix_pin(ix, off, U(exp + 4, 4));
+
+	nnames = U(off + 24, 4);
+	rva = U(off + 28, 4); RVA2OFF(rva, funcs);
+	rva = U(off + 32, 4); RVA2OFF(rva, names);
+	rva = U(off + 36, 4); RVA2OFF(rva, ords);
+	ix->job.total = nnames;
+	for (i = 0; i < nnames && !ix->job.cancel; i++, ix->job.progress++) {
+		if (!IN(ix, names + i * 4, 4) || !IN(ix, ords + i * 2, 2)) break;
+		j = U(ords + i * 2, 2);
+		if (!IN(ix, funcs + j * 4, 4)) continue;
+		rva = U(funcs + j * 4, 4); RVA2OFF(rva, off);
+		rva = U(names + i * 4, 4); RVA2OFF(rva, j);
+		if (IN(ix, j, 1)) ix_symbol(ix, d + j, ix->len - j, off);
+	}
+#undef RVA2OFF
+	return 0;
+}
+
+static int macho_parse(INDEX *ix)
+{
+	const uint8_t *d;
+	uint64_t p, ncmds, cmd, size, i, j, nsects, s, symoff, nsyms, stroff, off, strx, value;
+	uint64_t *secaddr, *secoff;
+	size_t nsec, cap;
+	int le, is64, type, sect;
+	char name[40];
+
+	d = ix->data;
+	ix_pin(ix, 0, 65536);
+	if (ix->len < 32) return -1;
+	     if (peek_uint(d, 4, 1) == 0xfeedfacf) { le = 1; is64 = 1; }
+	else if (peek_uint(d, 4, 0) == 0xfeedfacf) { le = 0; is64 = 1; }
+	else if (peek_uint(d, 4, 1) == 0xfeedface) { le = 1; is64 = 0; }
+	else if (peek_uint(d, 4, 0) == 0xfeedface) { le = 0; is64 = 0; }
+	else return -1;
+	ix->format = is64 ? "Mach-O 64" : "Mach-O";
+
+	secaddr = secoff = NULL;
+	nsec = cap = 0;
+	symoff = nsyms = stroff = 0;
+
+	ncmds = U(16, 4);
+	p = is64 ? 32 : 28;
+	for (i = 0; i < ncmds && IN(ix, p, 8); i++, p += size) {
+		cmd  = U(p, 4);
+		size = U(p + 4, 4);
+		if (size < 8 || !IN(ix, p, size)) break;
+
+		if (cmd == 0x19 || cmd == 0x1) { /* LC_SEGMENT_64, LC_SEGMENT */
+			snprintf(name, sizeof(name), "%.16s", (const char *)d + p + 8);
+			if (is64) ix_region(ix, U(p + 40, 8), U(p + 48, 8), R_SEGMENT, name, sizeof(name));
+			else      ix_region(ix, U(p + 32, 4), U(p + 36, 4), R_SEGMENT, name, sizeof(name));
+
+			nsects = is64 ? U(p + 64, 4) : U(p + 48, 4);
+			s = p + (is64 ? 72 : 56);
+			for (j = 0; j < nsects && s + (is64 ? 80 : 68) <= p + size; j++, s += is64 ? 80 : 68) {
+				if (nsec == cap) {
+					cap = cap ? cap * 2 : 16;
+					secaddr = realloc(secaddr, cap * sizeof(uint64_t));
+					secoff  = realloc(secoff,  cap * sizeof(uint64_t));
+					if (!secaddr || !secoff) goto done;
+				}
+				secaddr[nsec] = is64 ? U(s + 32, 8) : U(s + 32, 4);
+				secoff[nsec]  = is64 ? U(s + 48, 4) : U(s + 40, 4);
+				size = is64 ? U(s + 40, 8) : U(s + 36, 4);
+				snprintf(name, sizeof(name), "%.16s,%.16s", (const char *)d + s + 16, (const char *)d + s);
+				if ((U(s + (is64 ? 64 : 56), 4) & 0xff) != 1) { /* not S_ZEROFILL */
+					ix_region(ix, secoff[nsec], size, R_SECTION, name, sizeof(name));
+				}
+				nsec++;
+			}
+			size = U(p + 4, 4);
+
+		} else if (cmd == 0x2) { /* LC_SYMTAB */
+			symoff = U(p + 8, 4);
+			nsyms  = U(p + 12, 4);
+			stroff = U(p + 16, 4);
+			ix_pin(ix, stroff, U(p + 20, 4));
+		}
+	}
+
+	s = is64 ? 16 : 12;
+	ix_pin(ix, symoff, nsyms * s);
+	ix->job.total = nsyms;
+	for (i = 0; i < nsyms && IN(ix, symoff + i * s, s) && !ix->job.cancel; i++, ix->job.progress++) {
+		off   = symoff + i * s;
+		strx  = U(off, 4);
+		type  = d[off + 4];
+		sect  = d[off + 5];
+		value = is64 ? U(off + 8, 8) : U(off + 8, 4);
+		if ((type & 0xe0) || (type & 0x0e) != 0x0e || sect < 1 || sect > nsec) continue; /* N_STAB, !N_SECT */
+
+		off = stroff + strx;
+		if (IN(ix, off, 1)) ix_symbol(ix, d + off, ix->len - off, secoff[sect - 1] + value - secaddr[sect - 1]);
+	}
+
+done:
+	free(secaddr);
+	free(secoff);
+	return 0;
+}
+#undef U
+
+static int regioncmp(const void *_a, const void *_b)
+{
+	const REGION *a = _a, *b = _b;
+
+	if (a->start != b->start) return a->start < b->start ? -1 : 1;
+	if (a->end   != b->end)   return a->end   > b->end   ? -1 : 1; /* outermost first */
+	return 0;
+}
+
+static uint64_t fnv1a(const char *s)
+{
+	uint64_t h;
+
+	for (h = 0xcbf29ce484222325ULL; *s; s++) {
+		h ^= (uint8_t)*s;
+		h *= 0x100000001b3ULL;
+	}
+	return h;
+}
+
+SYMBOL* ix_lookup(INDEX *ix, const char *name)
+{
+	size_t h;
+
+	if (!ix->hashsize) return NULL;
+	for (h = fnv1a(name) & (ix->hashsize - 1); ix->hash[h]; h = (h + 1) & (ix->hashsize - 1)) {
+		if (strcmp(ix->pool + ix->syms[ix->hash[h] - 1].name, name) == 0) {
+			return &ix->syms[ix->hash[h] - 1];
+		}
+	}
+	return NULL;
+}
+
+/* the innermost region containing `off`; sections win over segments */
+REGION* ix_region_at(INDEX *ix, uint64_t off)
+{
+	REGION *r, *best;
+	size_t lo, hi, mid, i;
+
+	lo = 0; hi = ix->nregions;
+	while (lo < hi) { /* how many regions start at or before off? */
+		mid = (lo + hi) / 2;
+		if (ix->regions[mid].start <= off) lo = mid + 1;
+		else hi = mid;
+	}
+
+	best = NULL;
+	for (i = lo; i-- > 0 && ix->maxend[i] > off; ) {
+		r = &ix->regions[i];
+		if (r->end <= off) continue;
+		if (!best || r->kind > best->kind
+		 || (r->kind == best->kind && r->end - r->start < best->end - best->start)) best = r;
+	}
+	return best;
+}
+
+/* does a region start right at `off`? */
+int ix_boundary(INDEX *ix, uint64_t off)
+{
+	size_t lo, hi, mid;
+
+	lo = 0; hi = ix->nregions;
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (ix->regions[mid].start < off) lo = mid + 1;
+		else hi = mid;
+	}
+	return lo < ix->nregions && ix->regions[lo].start == off;
+}
+
+static void *ix_build(void *_)
+{
+	INDEX *ix;
+	size_t i, h;
+
+	ix = (INDEX *)_;
+
+	if (proc_parse(ix) != 0 && elf_parse(ix) != 0 && pe_parse(ix) != 0 && macho_parse(ix) != 0) {
+		ix->format = NULL;
+		ix->nregions = ix->nsyms = 0;
+	}
+	for (i = 0; i < ix->npins; i++) {
+		src_unpin(ix->src, ix->pins[i][0], ix->pins[i][1]);
+	}
+
+	qsort(ix->regions, ix->nregions, sizeof(REGION), regioncmp);
+	ix->maxend = calloc(ix->nregions + 1, sizeof(uint64_t));
+	for (i = 0; ix->maxend && i < ix->nregions; i++) {
+		ix->maxend[i] = max(i ? ix->maxend[i - 1] : 0, ix->regions[i].end);
+	}
+	if (!ix->maxend) ix->nregions = 0;
+
+	for (ix->hashsize = 16; ix->hashsize < 2 * ix->nsyms; ix->hashsize *= 2);
+	ix->hash = calloc(ix->hashsize, sizeof(uint32_t));
+	for (i = 0; ix->hash && i < ix->nsyms; i++) {
+		for (h = fnv1a(ix->pool + ix->syms[i].name) & (ix->hashsize - 1); ix->hash[h]; h = (h + 1) & (ix->hashsize - 1)) {
+			if (strcmp(ix->pool + ix->syms[ix->hash[h] - 1].name, ix->pool + ix->syms[i].name) == 0) break;
+		}
+		if (!ix->hash[h]) ix->hash[h] = i + 1; /* first definition wins */
+	}
+	if (!ix->hash) ix->hashsize = 0;
+
+	ix->job.done = 1;
+	return NULL;
+}
+
+/* the structure index, if it's ready; the first call starts building it */
+INDEX* lindex(LAYOUT *l)
+{
+	if (!l->index) {
+		l->index = calloc(1, sizeof(INDEX));
+		if (!l->index) return NULL;
+		l->index->data = l->data;
+		l->index->len  = l->len;
+		l->index->src  = l->src;
+		if (job_start(&l->index->job, ix_build, l->index) != 0) {
+			l->index->job.done = 1;
+		}
+	}
+	return l->index->job.done ? l->index : NULL;
+}
+
+void lindex_free(LAYOUT *l)
+{
+	INDEX *ix;
+
+	ix = l->index;
+	if (!ix) return;
+	job_stop(&ix->job);
+	free(ix->regions);
+	free(ix->maxend);
+	free(ix->syms);
+	free(ix->hash);
+	free(ix->pool);
+	free(ix);
+	l->index = NULL;
+}
+/* }}} */
+/* duplicate blocks {{{ */
+/* The image is cut into blocks where a gear hash of the last 64 or so
+   octets has its top bits clear (content-defined chunking), so that
+   the same data cuts the same way wherever it sits.  Each block is
+   hashed, and blocks whose hashes come up more than once are kept.
+
+   Memory is bounded by DUP_CAP blocks, however big the image is: when
+   a worker fills its share, it starts keeping only blocks whose hash
+   has one more top bit clear (and drops those that don't).  That
+   sampling depends only on content, so copies of a block are kept or
+   dropped together. */
+#define DUP_MIN     256           /* shortest block, except at the end */
+#define DUP_MAXLEN  8192          /* longest block */
+#define DUP_CUT     0xffc0000000000000ULL /* ~1k blocks, past DUP_MIN */
+#define DUP_LENBITS 14
+#define DUP_AT(x)   ((x) >> DUP_LENBITS)
+#define DUP_LEN(x)  ((x) & ((1 << DUP_LENBITS) - 1))
+#define DUP_CAP     (1 << 21)     /* most blocks held at once, overall */
+#define DUP_THREADS 16
+
+static uint64_t gear[256];
+
+typedef struct {
+	DUPS *d;
+	size_t from, to;
+	uint64_t *blk;    /* hash, DUP_AT|DUP_LEN pairs */
+	size_t n, cap;
+	size_t seen;      /* blocks cut, kept or not */
+	int level;        /* blocks kept have this many top hash bits clear */
+	pthread_t tid;
+} DUPSLICE;
+
+static uint64_t dup_hash(const uint8_t *p, size_t n)
+{
+	uint64_t h, w;
+	size_t i;
+
+	h = n * 0x9e3779b97f4a7c15ULL;
+	for (i = 0; i + 8 <= n; i += 8) {
+		memcpy(&w, p + i, 8);
+		h = (h ^ w) * 0xff51afd7ed558ccdULL;
+		h ^= h >> 32;
+	}
+	for (; i < n; i++) {
+		h = (h ^ p[i]) * 0x100000001b3ULL;
+	}
+	h ^= h >> 29;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	return h ^ h >> 32;
+}
+
+#define DUP_KEEP(h, level) ((level) == 0 || (h) >> (64 - (level)) == 0)
+
+static void dup_emit(DUPSLICE *w, const uint8_t *p, size_t at, size_t n)
+{
+	uint64_t h;
+	size_t i, k;
+
+	h = dup_hash(p + at, n);
+	w->seen++;
+	if (!DUP_KEEP(h, w->level)) return;
+	while (w->n == w->cap) { /* full: sample more sparsely */
+		w->level++;
+		for (k = i = 0; i < w->n; i++) {
+			if (!DUP_KEEP(w->blk[2 * i], w->level)) continue;
+			w->blk[2 * k]     = w->blk[2 * i];
+			w->blk[2 * k + 1] = w->blk[2 * i + 1];
+			k++;
+		}
+		w->n = k;
+		if (!DUP_KEEP(h, w->level)) return;
+	}
+	w->blk[2 * w->n]     = h;
+	w->blk[2 * w->n + 1] = (uint64_t)at << DUP_LENBITS | n;
+	w->n++;
+}
+
+/* cuts [from, to) into blocks */
+static void dup_cut(DUPSLICE *w, PINWIN *pw, size_t from, size_t to)
+{
+	DUPS *d;
+	const uint8_t *p;
+	size_t i, i0, end, start;
+	uint64_t h;
+
+	d = w->d;
+	p = d->data;
+	h = 0;
+	start = from;
+	i = start + DUP_MIN - 64; /* the cut only sees the last 64 octets */
+	while (i < to && !d->job.cancel) {
+		i0  = i;
+		end = min((i / SRC_CHUNK + 1) * SRC_CHUNK, to);
+		pw_need(pw, start, end - start);
+		for (; i < end; i++) {
+			h = (h << 1) + gear[p[i]];
+			if (i + 1 - start < DUP_MIN) continue;
+			if ((h & DUP_CUT) && i + 1 - start < DUP_MAXLEN) continue;
+
+			dup_emit(w, p, start, i + 1 - start);
+			start = i + 1;
+			i = start + DUP_MIN - 64 - 1;
+			h = 0;
+		}
+		__atomic_fetch_add(&d->job.progress, min(i, to) - min(i0, to), __ATOMIC_RELAXED);
+	}
+	if (start < to && !d->job.cancel) {
+		pw_need(pw, start, to - start);
+		dup_emit(w, p, start, to - start);
+	}
+}
+
+/* blocks never span holes; each stretch of data is cut on its own */
+static void *dup_slice(void *_)
+{
+	DUPSLICE *w;
+	DUPS *d;
+	PINWIN pw;
+	size_t at, next, stop;
+
+	w = (DUPSLICE *)_;
+	d = w->d;
+	memset(&pw, 0, sizeof(pw));
+	pw.src = d->src;
+
+	for (at = w->from; at < w->to && !d->job.cancel; at = stop) {
+		next = min(ext_next(d->ext, d->nextents, at, 0, &stop), w->to);
+		__atomic_fetch_add(&d->job.progress, next - at, __ATOMIC_RELAXED);
+		if (next == w->to) break;
+		stop = min(stop, w->to);
+		dup_cut(w, &pw, next, stop);
+	}
+	pw_done(&pw);
+	return NULL;
+}
+
+static int paircmp(const void *a, const void *b)
+{
+	const uint64_t *x = a, *y = b;
+
+	if (x[0] != y[0]) return x[0] < y[0] ? -1 : 1;
+	return x[1] < y[1] ? -1 : x[1] > y[1];
+}
+
+static void *dup_run(void *_)
+{
+	DUPS *d;
+	DUPSLICE w[DUP_THREADS];
+	uint64_t *all, s;
+	size_t i, j, k, n, slice;
+	int nw;
+
+	d = (DUPS *)_;
+	d->job.total = d->size;
+
+	nw = nworkers(DUP_THREADS);
+	slice = (d->size / nw + SRC_CHUNK) / SRC_CHUNK * SRC_CHUNK;
+	memset(w, 0, sizeof(w));
+	for (i = 0; i < nw; i++) {
+		w[i].d    = d;
+		w[i].from = min(i * slice, d->size);
+		w[i].to   = min((i + 1) * slice, d->size);
+		w[i].cap  = DUP_CAP / nw;
+		w[i].blk  = malloc(w[i].cap * 2 * sizeof(uint64_t));
+		if (!w[i].blk || w[i].from == w[i].to || pthread_create(&w[i].tid, NULL, dup_slice, &w[i]) != 0) {
+			w[i].to = w[i].from; /* nothing to join */
+		}
+	}
+	for (n = 0, i = 0; i < nw; i++) {
+		if (w[i].to > w[i].from) pthread_join(w[i].tid, NULL);
+		d->level = max(d->level, w[i].level);
+		n += w[i].n;
+	}
+
+	/* every slice samples as sparsely as the sparsest one did */
+	all = malloc(n * 2 * sizeof(uint64_t) + 1);
+	for (n = 0, i = 0; all && i < nw; i++) {
+		for (k = 0; k < w[i].n; k++) {
+			if (!DUP_KEEP(w[i].blk[2 * k], d->level)) continue;
+			all[2 * n]     = w[i].blk[2 * k];
+			all[2 * n + 1] = w[i].blk[2 * k + 1];
+			n++;
+		}
+		d->nblocks += w[i].seen;
+	}
+	for (i = 0; i < nw; i++) {
+		free(w[i].blk);
+	}
+	if (!all || d->job.cancel) goto done;
+
+	/* group copies together (in offset order), and keep only groups
+	   of two or more, remembering where each group starts */
+	qsort(all, n, 2 * sizeof(uint64_t), paircmp);
+	d->blk   = malloc(n * sizeof(DUPBLOCK) + 1);
+	d->byoff = malloc(n * 2 * sizeof(uint64_t) + 1);
+	if (!d->blk || !d->byoff) goto done;
+	for (i = 0; i < n; i = j) {
+		for (j = i + 1; j < n && all[2 * j] == all[2 * i]; j++);
+		if (j - i < 2) continue;
+		d->groups++;
+		for (s = d->n, k = i; k < j; k++) {
+			d->blk[d->n].at    = all[2 * k + 1];
+			d->blk[d->n].first = s;
+			d->blk[d->n].count = j - i;
+			d->n++;
+		}
+	}
+	for (i = 0; i < d->n; i++) {
+		d->byoff[2 * i]     = DUP_AT(d->blk[i].at);
+		d->byoff[2 * i + 1] = i;
+	}
+	qsort(d->byoff, d->n, 2 * sizeof(uint64_t), paircmp);
+
+done:
+	free(all);
+	d->job.done = 1;
+	return NULL;
+}
+
+/* the duplicated block at `at`, if there is one */
+DUPBLOCK* dup_at(DUPS *d, size_t at)
+{
+	size_t lo, hi, mid;
+	DUPBLOCK *b;
+
+	for (lo = 0, hi = d->n; lo < hi; ) {
+		mid = (lo + hi) / 2;
+		if (d->byoff[2 * mid] <= at) lo = mid + 1;
+		else                         hi = mid;
+	}
+	if (lo == 0) return NULL;
+	b = &d->blk[d->byoff[2 * (lo - 1) + 1]];
+	return at < DUP_AT(b->at) + DUP_LEN(b->at) ? b : NULL;
+}
+
+/* the duplicate pass, if it's finished; the first call starts it */
+DUPS* ldups(LAYOUT *l)
+{
+	uint64_t x;
+	int i;
+
+	if (!l->dups) {
+		l->dups = calloc(1, sizeof(DUPS));
+		if (!l->dups) return NULL;
+		for (x = 0x5eed, i = 0; i < 256; i++) { /* splitmix64 */
+			x += 0x9e3779b97f4a7c15ULL;
+			gear[i] = x;
+			gear[i] = (gear[i] ^ gear[i] >> 30) * 0xbf58476d1ce4e5b9ULL;
+			gear[i] = (gear[i] ^ gear[i] >> 27) * 0x94d049bb133111ebULL;
+			gear[i] ^= gear[i] >> 31;
+		}
+		l->dups->data = l->data;
+		l->dups->src  = l->src;
+		l->dups->ext  = l->extents;
+		l->dups->nextents = l->nextents;
+		l->dups->size = l->src ? l->src->len : l->len;
+		if (job_start(&l->dups->job, dup_run, l->dups) != 0) {
+			l->dups->job.done = 1;
+		}
+	}
+	return l->dups->job.done ? l->dups : NULL;
+}
+/* }}} */
+
+static void anyexit(int rc)
+{
+	printw("press any key to exit...");
+	refresh();
+	getch();
+	endwin();
+	exit(rc);
+}
+
+void cfgcol(COLUMN *c, prcell_fn pr, int width, int space)
+{
+	c->pr    = pr;
+	c->width = width;
+	c->space = space;
+}
+
+/* how far right the columns reach, at `width` octets a row */
+static int ledge(LAYOUT *l, int width)
+{
+	int i, x;
+
+	x = 1;
+	for (i = 0; i < l->ncol; i++) {
+		x += l->columns[i].width * width;
+		if (i + 1 < l->ncol) x += GUTTER - l->columns[i].space;
+	}
+	return x;
+}
+
+/* makes the column windows for `width` octets a row, cut off at the
+   right edge of a screen too narrow for them */
+static void lcolumns(LAYOUT *l, int width)
+{
+	int i, x, w;
+
+	l->width = width;
+	x = 1;
+	for (i = 0; i < l->ncol; i++) {
+		if (l->columns[i].win) delwin(l->columns[i].win);
+		w = l->columns[i].width * width;
+		l->columns[i].win = newwin(l->main_height, max(min(w, COLS - x), 1), 0, min(x, COLS - 1));
+		x += w + GUTTER - l->columns[i].space;
+	}
+	l->panel_x = x;
+}
+
+/* lays the columns out for `width` octets a row; fails (leaving the
+   old layout alone) if they wouldn't fit on the screen */
+int lwidth(LAYOUT *l, int width)
+{
+	if (width < 1 || ledge(l, width) > COLS) {
+		errno = ENOSPC;
+		return -1;
+	}
+	lcolumns(l, width);
+	return 0;
+}
+
+/* the most octets a row can hold, on this screen */
+int lmaxwidth(LAYOUT *l)
+{
+	int cells;
+
+	cells = ledge(l, 1) - ledge(l, 0);
+	return cells ? max((COLS - ledge(l, 0)) / cells, 1) : 1;
+}
+
+/* the octets at the cursor; off an octet boundary, these are what the
+   octets would be if the data started at the cursor's bit */
+const uint8_t* lcursor(LAYOUT *l)
+{
+	size_t at, i;
+	int hi, lo;
+
+	if (!l->bit) return DATA_AT(l, l->pos);
+
+	at = l->offset + l->pos;
+	for (i = 0; i < CURSOR_MAX; i++) {
+		hi = at + i     < l->len ? l->data[at + i]     : 0;
+		lo = at + i + 1 < l->len ? l->data[at + i + 1] : 0;
+		l->curbuf[i] = hi << l->bit | lo >> (8 - l->bit);
+	}
+	return l->curbuf;
+}
+
+/* put the cursor on absolute offset `at`, scrolling as needed */
+void lgoto(LAYOUT *l, size_t at)
+{
+	l->bit = 0;
+	if (l->extents) {
+		if (at < l->offset || lrows_to(l, l->offset, lrow(l, at)) < 0) {
+			l->offset = lrow(l, at);
+		}
+		l->pos = at - l->offset;
+		return;
+	}
+	if (at < l->offset || at >= l->offset + (l->main_height - 1) * l->width) {
+		l->offset = at - at % l->width;
+	}
+	l->pos = at - l->offset;
+}
+
+void notef(LAYOUT *l, const char *msg, ...)
+{
+	va_list ap;
+
+	werase(l->command);
+	wmove(l->command, 0, 0);
+
+	va_start(ap, msg);
+	vw_printw(l->command, msg, ap);
+	va_end(ap);
+
+	wrefresh(l->command);
+}
+
+void errorf(LAYOUT * l, const char *msg, ...)
+{
+	va_list ap;
+
+	if (!l) { /* not on the screen (yet), as with --grep */
+		va_start(ap, msg);
+		fprintf(stderr, "vex: ");
+		vfprintf(stderr, msg, ap);
+		fprintf(stderr, "\n");
+		va_end(ap);
+		return;
+	}
+	wattron(l->command, C_ERROR);
+	werase(l->command);
+	wmove(l->command, 0, 0);
+
+	va_start(ap, msg);
+	vwprintw(l->command, msg, ap);
+	va_end(ap);
+
+	wattroff(l->command, C_ERROR);
+	wrefresh(l->command);
+}
+/* }}} */
+
+static void pr_ascii(WINDOW *w, uint8_t v) /* {{{ */
+{
+	if (v < 32 || v > 126) {
+		waddch(w, '.');
+	} else {
+		waddch(w, v);
+	}
+}
+/* }}} */
+static void pr_hex(WINDOW *w, uint8_t v) /* {{{ */
+{
+	wprintw(w, "%02x", v);
+	wattroff(w, C_CURSOR);
+	waddch(w, ' ');
+}
+/* }}} */
+static void pr_hex_pretty(WINDOW *w, uint8_t v) /* {{{ */
+{
+	if (v == 0) {
+		waddch(w, '-');
+		waddch(w, ' ');
+		wattroff(w, C_CURSOR);
+		waddch(w, ' ');
+	} else {
+		/* the space stays bold, so a run of octets is one run of
+		   bold on the wire, not a switch on and off for each */
+		wattron(w, A_BOLD);
+		wprintw(w, "%02x", v);
+		wattroff(w, C_CURSOR);
+		waddch(w, ' ');
+		wattroff(w, A_BOLD);
+	}
+}
+/* }}} */
+static void pr_oct(WINDOW *w, uint8_t v) /* {{{ */
+{
+	wprintw(w, "% 3o", v);
+	wattroff(w, C_CURSOR);
+	waddch(w, ' ');
+}
+/* }}} */
+static void pr_oct_pretty(WINDOW *w, uint8_t v) /* {{{ */
+{
+	if (v == 0) {
+		waddch(w, ' ');
+		waddch(w, '-');
+		waddch(w, ' ');
+		wattroff(w, C_CURSOR);
+		waddch(w, ' ');
+	} else {
+		/* bold through the space, as pr_hex_pretty() does */
+		wattron(w, A_BOLD);
+		wprintw(w, "% 3o", v);
+		wattroff(w, C_CURSOR);
+		waddch(w, ' ');
+		wattroff(w, A_BOLD);
+	}
+}
+/* }}} */
+
+/* terminal output {{{ */
+/* ncurses keeps a shadow of the screen and only sends the cells that
+   changed, provided nothing asks it to clear; what it writes for each
+   frame is the measure of how well we let it.  Linux counts what each
+   thread write()s, and the UI thread writes nothing but the screen. */
+static int    tty_io = -2;
+static size_t tty_last, tty_frames;
+
+static long long tty_written(void)
+{
+	char buf[512], *p;
+	ssize_t n;
+
+	if (tty_io == -2) tty_io = open("/proc/thread-self/io", O_RDONLY | O_CLOEXEC);
+	if (tty_io < 0) return -1;
+	n = pread(tty_io, buf, sizeof(buf) - 1, 0);
+	if (n <= 0) return -1;
+	buf[n] = '\0';
+	p = strstr(buf, "wchar:");
+	return p ? strtoll(p + 6, NULL, 10) : -1;
+}
+
+/* sends a frame to the terminal, keeping count of what it cost */
+static void frame(void)
+{
+	long long a, b;
+
+	a = tty_written();
+	doupdate();
+	b = tty_written();
+	if (a >= 0 && b >= a) {
+		tty_last = b - a;
+		tty_frames++;
+	}
+}
+/* }}} */
+
+/* annotations {{{ */
+/* `:annotate FILE` labels ranges of the image, given one per line as
+
+       OFFSET LENGTH COLOR LABEL...
+
+   with OFFSET and LENGTH in decimal or 0x-hex, and COLOR one of red,
+   green, yellow, blue, magenta, cyan or white (or '-', to leave the
+   octets alone).  Analyzers write millions of these, so the file is
+   mapped rather than read, the labels are left where they are in it,
+   and each annotation costs 32 octets.
+
+   The annotations are sorted by offset, and the sorted array doubles
+   as an interval tree (as in Heng Li's cgranges): node i sits at level
+   k when its lowest k bits are all set, the level-0 nodes being the
+   even ones, and each node keeps the furthest end in its subtree.  A
+   query descends only into subtrees that can reach it, in O(log n)
+   plus the number of hits. */
+static const char *ANNOT_COLORS[] = {
+	"-", "red", "green", "yellow", "blue", "magenta", "cyan", "white", NULL,
+};
+
+static int annot_cmp(const void *_a, const void *_b)
+{
+	const ANNOT *a = _a, *b = _b;
+
+	if (a->start != b->start) return a->start < b->start ? -1 : 1;
+	return a->end > b->end ? -1 : a->end < b->end;
+}
+
+/* reads a decimal or 0x-hex number at *p, before end */
+static int annot_num(const char **p, const char *end, uint64_t *v)
+{
+	const char *s;
+	int base, d;
+
+	for (s = *p; s < end && (*s == ' ' || *s == '\t'); s++);
+	base = 10;
+	if (end - s > 2 && s[0] == '0' && (s[1] == 'x' || s[1] == 'X')) {
+		base = 16;
+		s += 2;
+	}
+	for (*v = 0, *p = s; s < end; s++) {
+		if      (*s >= '0' && *s <= '9')               d = *s - '0';
+		else if (base == 16 && isxdigit((unsigned char)*s)) d = tolower(*s) - 'a' + 10;
+		else break;
+		*v = *v * base + d;
+	}
+	if (s == *p || (s < end && !isspace((unsigned char)*s))) return 0;
+	*p = s;
+	return 1;
+}
+
+/* fills in each node's reach; returns the height of the tree */
+static int annot_index(ANNOT *a, size_t n)
+{
+	size_t i, x, last_i;
+	uint64_t last, e;
+	int k;
+
+	last = last_i = 0;
+	for (i = 0; i < n; i += 2) {
+		last_i = i;
+		last   = a[i].reach = a[i].end;
+	}
+	for (k = 1; ((size_t)1 << k) <= n; k++) {
+		x = (size_t)1 << (k - 1);
+		for (i = (x << 1) - 1; i < n; i += x << 2) {
+			e = max(a[i].end, a[i - x].reach);
+			a[i].reach = max(e, i + x < n ? a[i + x].reach : last);
+		}
+		last_i = (last_i >> k & 1) ? last_i - x : last_i + x;
+		if (last_i < n && a[last_i].reach > last) last = a[last_i].reach;
+	}
+	return k - 1;
+}
+
+/* calls fn for every annotation that overlaps [st, en) */
+static void annot_query(ANNOTS *an, uint64_t st, uint64_t en,
+                        void (*fn)(ANNOTS *, size_t, void *), void *u)
+{
+	struct { size_t x; int k, w; } stack[64], z;
+	size_t i, i0, i1, y;
+	int t;
+
+	if (!an->n) return;
+	t = 0;
+	stack[t].k = an->levels; stack[t].x = ((size_t)1 << an->levels) - 1; stack[t++].w = 0;
+	while (t) {
+		z = stack[--t];
+		if (z.k <= 3) { /* small enough to just scan */
+			i0 = z.x >> z.k << z.k;
+			i1 = min(i0 + ((size_t)1 << (z.k + 1)) - 1, an->n);
+			for (i = i0; i < i1 && an->a[i].start < en; i++) {
+				if (st < an->a[i].end) (*fn)(an, i, u);
+			}
+		} else if (z.w == 0) { /* the left subtree, first */
+			y = z.x - ((size_t)1 << (z.k - 1));
+			stack[t].k = z.k; stack[t].x = z.x; stack[t++].w = 1;
+			if (y >= an->n || an->a[y].reach > st) {
+				stack[t].k = z.k - 1; stack[t].x = y; stack[t++].w = 0;
+			}
+		} else if (z.x < an->n && an->a[z.x].start < en) {
+			if (st < an->a[z.x].end) (*fn)(an, z.x, u);
+			stack[t].k = z.k - 1; stack[t].x = z.x + ((size_t)1 << (z.k - 1)); stack[t++].w = 0;
+		}
+	}
+}
+
+/* does annotation i win over j (an index + 1, or 0 for none)?  The
+   innermost, shortest annotation is the one shown */
+static int annot_inner(ANNOTS *an, size_t i, uint32_t j)
+{
+	return !j || an->a[i].end - an->a[i].start <= an->a[j - 1].end - an->a[j - 1].start;
+}
+
+static void annot_paint1(ANNOTS *an, size_t i, void *_)
+{
+	uint64_t at, end;
+
+	at  = max(an->a[i].start, an->paint_at);
+	end = min(an->a[i].end,   an->paint_at + an->paint_len);
+	for (; at < end; at++) {
+		if (annot_inner(an, i, an->paint[at - an->paint_at])) {
+			an->paint[at - an->paint_at] = i + 1;
+		}
+	}
+}
+
+/* works out the innermost annotation for each of the len octets at `at` */
+void annot_paint(ANNOTS *an, size_t at, size_t len)
+{
+	uint32_t *p;
+
+	if (len > an->paint_cap) {
+		p = realloc(an->paint, len * sizeof(uint32_t));
+		if (!p) len = an->paint_cap;
+		else    an->paint = p, an->paint_cap = len;
+	}
+	an->paint_at  = at;
+	an->paint_len = len;
+	if (!len) return;
+	memset(an->paint, 0, len * sizeof(uint32_t));
+	annot_query(an, at, at + len, annot_paint1, NULL);
+}
+
+static void annot_at1(ANNOTS *an, size_t i, void *_j)
+{
+	uint32_t *j = _j;
+
+	if (annot_inner(an, i, *j)) *j = i + 1;
+}
+
+/* the innermost annotation at `at`, or NULL */
+ANNOT* annot_at(ANNOTS *an, size_t at)
+{
+	uint32_t j;
+
+	if (at >= an->paint_at && at - an->paint_at < an->paint_len) {
+		j = an->paint[at - an->paint_at];
+	} else {
+		j = 0;
+		annot_query(an, at, at + 1, annot_at1, &j);
+	}
+	return j ? &an->a[j - 1] : NULL;
+}
+
+void annot_free(ANNOTS *an)
+{
+	if (!an) return;
+	if (an->map) munmap(an->map, an->maplen);
+	free(an->a);
+	free(an->paint);
+	free(an);
+}
+
+ANNOTS* annot_load(LAYOUT *l, const char *path)
+{
+	ANNOTS *an;
+	ANNOT *a;
+	struct stat st;
+	const char *p, *eol, *end, *w;
+	size_t cap;
+	uint64_t off, len;
+	int fd, lineno, c;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0 || fstat(fd, &st) != 0) {
+		errorf(l, "%s: %s", path, strerror(errno));
+		if (fd >= 0) close(fd);
+		return NULL;
+	}
+	if ((uint64_t)st.st_size > UINT32_MAX) {
+		errorf(l, "%s: too big for annotations", path);
+		close(fd);
+		return NULL;
+	}
+
+	an = calloc(1, sizeof(ANNOTS));
+	if (!an) goto nomem;
+	snprintf(an->path, sizeof(an->path), "%s", path);
+	an->maplen = st.st_size;
+	if (an->maplen) {
+		an->map = mmap(NULL, an->maplen, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (an->map == MAP_FAILED) {
+			an->map = NULL;
+			errorf(l, "%s: %s", path, strerror(errno));
+			goto fail;
+		}
+		madvise(an->map, an->maplen, MADV_SEQUENTIAL);
+	}
+	close(fd);
+	fd = -1;
+
+	cap = 0;
+	end = an->map + an->maplen;
+	for (lineno = 1, p = an->map; p < end; lineno++, p = eol + 1) {
+		eol = memchr(p, '\n', end - p);
+		if (!eol) eol = end;
+		while (p < eol && isspace((unsigned char)*p)) p++;
+		if (p == eol || *p == '#') continue;
+
+		if (!annot_num(&p, eol, &off) || !annot_num(&p, eol, &len)) {
+			errorf(l, "%s:%d: expected OFFSET LENGTH COLOR LABEL", path, lineno);
+			goto fail;
+		}
+		while (p < eol && (*p == ' ' || *p == '\t')) p++;
+		for (w = p; p < eol && !isspace((unsigned char)*p); p++);
+		for (c = 0; ANNOT_COLORS[c]; c++) {
+			if (strlen(ANNOT_COLORS[c]) == (size_t)(p - w)
+			 && strncmp(ANNOT_COLORS[c], w, p - w) == 0) break;
+		}
+		if (!ANNOT_COLORS[c] || len == 0 || off + len < off) {
+			errorf(l, "%s:%d: bad %s", path, lineno, ANNOT_COLORS[c] ? "range" : "color");
+			goto fail;
+		}
+
+		if (an->n == cap) {
+			cap = cap ? cap * 2 : 4096;
+			if (!(a = realloc(an->a, cap * sizeof(ANNOT)))) goto nomem;
+			an->a = a;
+		}
+		while (p < eol && (*p == ' ' || *p == '\t')) p++;
+		for (w = eol; w > p && isspace((unsigned char)w[-1]); w--);
+		a = &an->a[an->n++];
+		a->start = off;
+		a->end   = off + len;
+		a->label = p - an->map;
+		a->len   = min(w - p, 0xffff);
+		a->color = c;
+	}
+
+	qsort(an->a, an->n, sizeof(ANNOT), annot_cmp);
+	an->levels = annot_index(an->a, an->n);
+	madvise(an->map, an->maplen, MADV_RANDOM);
+	return an;
+
+nomem:
+	errorf(l, "%s: %s", path, strerror(ENOMEM));
+fail:
+	if (fd >= 0) close(fd);
+	annot_free(an);
+	return NULL;
+}
+/* }}} */
+
+static void fmt_literal(void *l, int width, void *_field) /* {{{ */
+{
+	wprintw(((LAYOUT *)l)->status, "%s", ((FIELD*)_field)->literal);
+} /* }}} */
+static void fmt_ud(void *_, int width, void *_field) /* {{{ */
+{
+	size_t left;
+	LAYOUT *l;
+
+	l = (LAYOUT*)_;
+	left = LEFT(l);
+
+	switch (width) {
+	case 8:
+		wprintw(l->status, "% 3u", as_u8(CURSOR(l)));
+		break;
+
+	case 16:
+		if (left >= 2) wprintw(l->status, "% 6u", as_u16(CURSOR(l)));
+		else           wprintw(l->status, "% 6s", "");
+		break;
+	case 32:
+		if (left >= 4) wprintw(l->status, "% 11u", as_u32(CURSOR(l)));
+		else           wprintw(l->status, "% 11s", "");
+		break;
+
+	case 64:
+		if (left >= 8) wprintw(l->status, "% 20lu", as_u64(CURSOR(l)));
+		else           wprintw(l->status, "% 20s", "");
+		break;
+
+	default:
+		wprintw(l->status, "!!!");
+		break;
+	}
+} /* }}} */
+static void fmt_sd(void *_, int width, void *_field) /* {{{ */
+{
+	size_t left;
+	LAYOUT *l;
+
+	l = (LAYOUT*)_;
+	left = LEFT(l);
+
+	switch (width) {
+	case 8:
+		wprintw(l->status, "% 3i", as_i8(CURSOR(l)));
+		break;
+
+	case 16:
+		if (left >= 2) wprintw(l->status, "% 6i", as_i16(CURSOR(l)));
+		else           wprintw(l->status, "% 6s", "");
+		break;
+	case 32:
+		if (left >= 4) wprintw(l->status, "% 11i", as_i32(CURSOR(l)));
+		else           wprintw(l->status, "% 11s", "");
+		break;
+
+	case 64:
+		if (left >= 8) wprintw(l->status, "% 20li", as_i64(CURSOR(l)));
+		else           wprintw(l->status, "% 20s", "");
+		break;
+
+	default:
+		wprintw(l->status, "!!!");
+		break;
+	}
+} /* }}} */
+static void fmt_lz(void *_, int width, void *_field) /* {{{ */
+{
+	size_t left;
+	LAYOUT *l;
+
+	l = (LAYOUT*)_;
+	left = LEFT(l);
+
+	switch (width) {
+	case 8:
+		wprintw(l->status, "%i", clz8(as_u8(CURSOR(l))));
+		break;
+	case 16:
+		if (left >= 2) wprintw(l->status, "% 2i", clz16(as_u16(CURSOR(l))));
+		else           wprintw(l->status, "  ");
+		break;
+	case 32:
+		if (left >= 4) wprintw(l->status, "% 2i", clz32(as_u32(CURSOR(l))));
+		else           wprintw(l->status, "  ");
+		break;
+	case 64:
+		if (left >= 8) wprintw(l->status, "% 2i", clz64(as_u64(CURSOR(l))));
+		else           wprintw(l->status, "  ");
+		break;
+	default:
+		wprintw(l->status, "!!!");
+		break;
+	}
+} /* }}} */
+static void fmt_tz(void *_, int width, void *_field) /* {{{ */
+{
+	size_t left;
+	LAYOUT *l;
+
+	l = (LAYOUT*)_;
+	left = LEFT(l);
+
+	switch (width) {
+	case 8:
+		wprintw(l->status, "%i", ctz8(as_u8(CURSOR(l))));
+		break;
+	case 16:
+		if (left >= 2) wprintw(l->status, "% 2i", ctz16(as_u16(CURSOR(l))));
+		else           wprintw(l->status, "  ");
+		break;
+	case 32:
+		if (left >= 4) wprintw(l->status, "% 2i", ctz32(as_u32(CURSOR(l))));
+		else           wprintw(l->status, "  ");
+		break;
+	case 64:
+		if (left >= 8) wprintw(l->status, "% 2i", ctz64(as_u64(CURSOR(l))));
+		else           wprintw(l->status, "  ");
+		break;
+	default:
+		wprintw(l->status, "!!!");
+		break;
+	}
+} /* }}} */
+static void fmt_p(void *_, int width, void *_field) /* {{{ */
+{
+	size_t left;
+	LAYOUT *l;
+
+	l = (LAYOUT*)_;
+	left = LEFT(l);
+
+	switch (width) {
+	case 8:
+		wprintw(l->status, "%i", pop8(as_u8(CURSOR(l))));
+		break;
 	case 16:
-		if (left >= 2) wprintw(l->status, "% 2i", pop16(as_u16(DATA_AT(l, l->pos))));
+		if (left >= 2) wprintw(l->status, "% 2i", pop16(as_u16(CURSOR(l))));
+		else           wprintw(l->status, "  ");
+		break;
+	case 32:
+		if (left >= 4) wprintw(l->status, "% 2i", pop32(as_u32(CURSOR(l))));
+		else           wprintw(l->status, "  ");
+		break;
+	case 64:
+		if (left >= 8) wprintw(l->status, "% 2i", pop64(as_u64(CURSOR(l))));
 		else           wprintw(l->status, "  ");
 		break;
+	default:
+		wprintw(l->status, "!!!");
+		break;
+	}
+} /* }}} */
+static void fmt_b(void *_, int width, void *_field) /* {{{ */
+{
+	int i;
+	uint64_t v;
+	LAYOUT *l;
+
+	l = (LAYOUT *)_;
+
+	switch (width) {
+	case 8:
+	case 16:
+	case 32:
+	case 64: break;
+	default:
+		wprintw(l->status, "!!!");
+		return;
+	}
+
+	for (i = 0; i < width / 8; i++) {
+		v = as_u8((CURSOR(l) + i));
+		if (i != 0) waddch(l->status, ' ');
+		waddch(l->status, (v & 0x80) ? '1' : '0');
+		waddch(l->status, (v & 0x40) ? '1' : '0');
+		waddch(l->status, (v & 0x20) ? '1' : '0');
+		waddch(l->status, (v & 0x10) ? '1' : '0');
+		waddch(l->status, ' ');
+		waddch(l->status, (v & 0x08) ? '1' : '0');
+		waddch(l->status, (v & 0x04) ? '1' : '0');
+		waddch(l->status, (v & 0x02) ? '1' : '0');
+		waddch(l->status, (v & 0x01) ? '1' : '0');
+	}
+} /* }}} */
+static void fmt_E(void *_, int width, void *_field) /* {{{ */
+{
+	LAYOUT *l;
+	uint8_t buf[2] = { 0xba, 0xab };
+
+	l = (LAYOUT *)_;
+	if (as_u16(buf) == 0xbaab) {
+		     if (width == 1) wprintw(l->status, "B");
+		else if (width == 2) wprintw(l->status, "BE");
+		else if (width == 3) wprintw(l->status, "big");
+		else if (width == 0) wprintw(l->status, "big-endian");
+		else                 wprintw(l->status, "!!!");
+	} else {
+		     if (width == 1) wprintw(l->status, "L");
+		else if (width == 2) wprintw(l->status, "LE");
+		else if (width == 3) wprintw(l->status, "lil");
+		else if (width == 0) wprintw(l->status, "little-endian");
+		else                 wprintw(l->status, "!!!");
+	}
+} /* }}} */
+static void fmt_o(void *_, int width, void *_field) /* {{{ */
+{
+	LAYOUT *l;
+
+	l = (LAYOUT *)_;
+	wprintw(l->status, "%ld", l->offset + l->pos);
+	if (l->bit) wprintw(l->status, ".%d", l->bit);
+} /* }}} */
+static void fmt_l(void *_, int width, void *_field) /* {{{ */
+{
+	LAYOUT *l;
+
+	l = (LAYOUT *)_;
+	wprintw(l->status, "%ld", l->len);
+	if (l->src && !l->src->complete) waddch(l->status, '+'); /* still indexing */
+} /* }}} */
+static void fmt_F(void *_, int width, void *_field) /* {{{ */
+{
+	LAYOUT *l;
+
+	l = (LAYOUT *)_;
+	wprintw(l->status, "%s", l->file);
+} /* }}} */
+static void fmt_P(void *_, int width, void *_field) /* {{{ */
+{
+	LAYOUT *l;
+
+	l = (LAYOUT *)_;
+	wprintw(l->status, "%s", l->path);
+} /* }}} */
+static void fmt_S(void *_, int width, void *_field) /* {{{ */
+{
+	LAYOUT *l;
+	INDEX *ix;
+	REGION *r;
+
+	l = (LAYOUT *)_;
+	ix = lindex(l);
+	if (!ix) {
+		wprintw(l->status, "%-*s", width, "...");
+		return;
+	}
+	r = ix_region_at(ix, l->offset + l->pos);
+	wprintw(l->status, "%-*s", width, r ? ix->pool + r->name : "-");
+} /* }}} */
+static void fmt_L(void *_, int width, void *_field) /* {{{ */
+{
+	LAYOUT *l;
+	ANNOT *a;
+
+	l = (LAYOUT *)_;
+	a = l->annots ? annot_at(l->annots, l->offset + l->pos) : NULL;
+	if (!a)         wprintw(l->status, "%-*s", width, "-");
+	else if (width) wprintw(l->status, "%-*.*s", width, min(width, a->len), l->annots->map + a->label);
+	else            wprintw(l->status, "%.*s", a->len, l->annots->map + a->label);
+} /* }}} */
+static void fmt_B(void *_, int width, void *_field) /* {{{ */
+{
+	LAYOUT *l;
+
+	l = (LAYOUT *)_;
+	if (tty_frames) wprintw(l->status, "%*zu", width, tty_last);
+	else            wprintw(l->status, "%*s", width, "-");
+} /* }}} */
+static void fmt_D(void *_, int width, void *_field) /* {{{ */
+{
+	LAYOUT *l;
+	DUPS *d;
+	DUPBLOCK *b;
+
+	l = (LAYOUT *)_;
+	if (!l->dups) {
+		wprintw(l->status, "%*s", width, "");
+		return;
+	}
+	d = ldups(l);
+	if (!d) {
+		wprintw(l->status, "%*s", width, "...");
+		return;
+	}
+	b = dup_at(d, l->offset + l->pos);
+	if (b)              wprintw(l->status, "%*u", width, b->count);
+	else if (d->level)  wprintw(l->status, "%*s", width, "?");
+	else                wprintw(l->status, "%*u", width, 1);
+} /* }}} */
+static void fmt_H(void *_, int width, void *_field) /* {{{ */
+{
+	LAYOUT *l;
+	char buf[64];
+
+	l = (LAYOUT *)_;
+	snprintf(buf, sizeof(buf), "%zu/%zu", l->pf.hits, l->pf.misses);
+	wprintw(l->status, "%*s", width, buf);
+} /* }}} */
+static void fmt_R(void *_, int width, void *_field) /* {{{ */
+{
+	LAYOUT *l;
+	FILE *io;
+	unsigned long pages, rss;
+	char buf[64], a[16], b[16];
+
+	l = (LAYOUT *)_;
+	rss = 0;
+	io = fopen("/proc/self/statm", "r");
+	if (io) {
+		if (fscanf(io, "%lu %lu", &pages, &rss) != 2) rss = 0;
+		fclose(io);
+	}
+	hsize(a, sizeof(a), (uint64_t)rss * sysconf(_SC_PAGESIZE));
+	if (l->budget) {
+		hsize(b, sizeof(b), l->budget);
+		snprintf(buf, sizeof(buf), "%s/%s", a, b);
+	} else {
+		snprintf(buf, sizeof(buf), "%s", a);
+	}
+	wprintw(l->status, "%*s", width, buf);
+} /* }}} */
+static void fmt_M(void *_, int width, void *_field) /* {{{ */
+{
+	LAYOUT *l;
+
+	l = (LAYOUT *)_;
+	wprintw(l->status, "%*s", width, l->ndirty ? "[+]" : l->patching ? "[=]" : "");
+} /* }}} */
+static void fmt_A(void *_, int width, void *_field) /* {{{ */
+{
+	LAYOUT *l;
+
+	l = (LAYOUT *)_;
+	wprintw(l->status, "%0*llx", width, (unsigned long long)laddr(l, l->offset + l->pos));
+} /* }}} */
+static void fmt_T(void *_, int width, void *_field) /* {{{ */
+{
+	size_t left;
+	int i;
+	LAYOUT *l;
+	char *s, *p;
+	time_t t;
+
+	l = (LAYOUT *)_;
+	left = LEFT(l);
+
+	if (left >= 4) {
+		//Wed Jun 30 21:49:08 1993\n
+		t = as_u32(CURSOR(l));
+		s = ctime(&t);
+		if (s) {
+			p = strchr(s, '\n');
+			if (p) *p = '\0';
+			wprintw(l->status, "%24s", s);
+		} else {
+			wprintw(l->status, "%24s", "-");
+		}
+	}
+	for (i = 0; i < width; i++) {
+		if (i != 0) waddch(l->status, ' ');
+		if (i > left || i >= CURSOR_MAX) {
+			waddch(l->status, ' ');
+			waddch(l->status, ' ');
+		} else {
+			wprintw(l->status, "%02x", as_u8((CURSOR(l) + i)));
+		}
+	}
+} /* }}} */
+static void fmt_x(void *_, int width, void *_field) /* {{{ */
+{
+	size_t left;
+	int i;
+	LAYOUT *l;
+
+	l = (LAYOUT *)_;
+	left = LEFT(l);
+
+	for (i = 0; i < width; i++) {
+		if (i != 0) waddch(l->status, ' ');
+		if (i > left || i >= CURSOR_MAX) {
+			waddch(l->status, ' ');
+			waddch(l->status, ' ');
+		} else {
+			wprintw(l->status, "%02x", as_u8((CURSOR(l) + i)));
+		}
+	}
+} /* }}} */
+static void fmt_f(void *_, int width, void *_field) /* {{{ */
+{
+	size_t left;
+	LAYOUT *l;
+
+	l = (LAYOUT *)_;
+	left = LEFT(l);
+
+	switch (width) {
+	case 32:
+		if (left >= 4) wprintw(l->status, "%f", as_f32(CURSOR(l)));
+		else           waddch(l->status, '-');
+		break;
+	case 64:
+		if (left >= 8) wprintw(l->status, "%lf", as_f64(CURSOR(l)));
+		else           waddch(l->status, '-');
+		break;
+	default:
+		wprintw(l->status, "!!!");
+		break;
+	}
+} /* }}} */
+static void fmt_e(void *_, int width, void *_field) /* {{{ */
+{
+	size_t left;
+	LAYOUT *l;
+
+	l = (LAYOUT *)_;
+	left = LEFT(l);
+
+	switch (width) {
 	case 32:
-		if (left >= 4) wprintw(l->status, "% 2i", pop32(as_u32(DATA_AT(l, l->pos))));
-		else           wprintw(l->status, "  ");
+		if (left >= 4) wprintw(l->status, "%e", as_f32(CURSOR(l)));
+		else           waddch(l->status, '-');
 		break;
 	case 64:
-		if (left >= 4) wprintw(l->status, "% 2i", pop64(as_u64(DATA_AT(l, l->pos))));
-		else           wprintw(l->status, "  ");
+		if (left >= 8) wprintw(l->status, "%le", as_f64(CURSOR(l)));
+		else           waddch(l->status, '-');
+		break;
+	default:
+		wprintw(l->status, "!!!");
+		break;
+	}
+} /* }}} */
+
+/* status bar functions {{{ */
+int parse_status(ARENA *arena, const char *s, FIELD *fields)
+{
+	int nfields, w;
+	const char *a, *b;
+
+	nfields = 0;
+	a = s;
+	while (*a) { /* until we run out of string ... */
+		b = strchr(a, '%');
+		if (!b) {
+			/* trailing string literal */
+			if (fields) {
+				fields[nfields].fmt     = fmt_literal;
+				fields[nfields].width   = -1;
+				fields[nfields].literal = arena_strdup(arena, a);
+			}
+			nfields++;
+			return nfields;
+		}
+		if (a != b) {
+			if (fields) {
+				fields[nfields].fmt     = fmt_literal;
+				fields[nfields].width   = -1;
+				fields[nfields].literal = arena_strndup(arena, a, b - a);
+			}
+			nfields++;
+		}
+
+		b++;
+		if (*b == '%') { /* '%%' */
+			a = b + 1;
+			continue;
+		}
+
+		w = 0;
+		while (isdigit(*b)) {
+			w = w * 10 + (*b) - '0';
+			b++;
+		}
+		if (fields) fields[nfields].width = w;
+
+		switch (*b) {
+		case 'u':
+			b++;
+			if (*b != 'd') {
+				printw("invalid format code '%%%du%c'\n", w, *b);
+				return -1;
+			}
+			if (fields) fields[nfields].fmt = fmt_ud;
+			break;
+
+		case 's':
+			b++;
+			if (*b != 'd') {
+				printw("invalid format code '%%%ds%c'\n", w, *b);
+				return -1;
+			}
+			if (fields) fields[nfields].fmt = fmt_sd;
+			break;
+
+		case 'z':
+			b++;
+			switch (*b) {
+			case 'l': if (fields) fields[nfields].fmt = fmt_lz; break;
+			case 't': if (fields) fields[nfields].fmt = fmt_tz; break;
+			default:
+				printw("invalid format code '%%%dz%c'\n", w, *b);
+				return -1;
+			}
+			break;
+
+		case 'x': if (fields) fields[nfields].fmt = fmt_x; break;
+		case 'f': if (fields) fields[nfields].fmt = fmt_f; break;
+		case 'e': if (fields) fields[nfields].fmt = fmt_e; break;
+		case 'b': if (fields) fields[nfields].fmt = fmt_b; break;
+		case 'E': if (fields) fields[nfields].fmt = fmt_E; break;
+		case 'o': if (fields) fields[nfields].fmt = fmt_o; break;
+		case 'l': if (fields) fields[nfields].fmt = fmt_l; break;
+		case 'F': if (fields) fields[nfields].fmt = fmt_F; break;
+		case 'P': if (fields) fields[nfields].fmt = fmt_P; break;
+		case 'S': if (fields) fields[nfields].fmt = fmt_S; break;
+		case 'D': if (fields) fields[nfields].fmt = fmt_D; break;
+		case 'L': if (fields) fields[nfields].fmt = fmt_L; break;
+		case 'B': if (fields) fields[nfields].fmt = fmt_B; break;
+		case 'H': if (fields) fields[nfields].fmt = fmt_H; break;
+		case 'R': if (fields) fields[nfields].fmt = fmt_R; break;
+		case 'M': if (fields) fields[nfields].fmt = fmt_M; break;
+		case 'A': if (fields) fields[nfields].fmt = fmt_A; break;
+		case 'T': if (fields) fields[nfields].fmt = fmt_T; break;
+		case 'p': if (fields) fields[nfields].fmt = fmt_p; break;
+
+		case 't':
+		case 'C':
+		case 'c':
+
+		default:
+			printw("invalid format code '%%%d%c'\n", w, *b);
+			return -1;
+		}
+		nfields++;
+		b++;
+
+		a = b;
+	}
+
+	return nfields;
+}
+
+void statusbar(LAYOUT *l)
+{
+	int i;
+	werase(l->status);
+	wmove(l->status, 0, 0);
+	for (i = 0; i < l->nfields; i++) {
+		(*l->fields[i].fmt)(l, l->fields[i].width, &l->fields[i]);
+	}
+	wnoutrefresh(l->status);
+}
+
+/* }}} */
+/* struct templates {{{ */
+#define DECODED_MAX 256
+
+int compile_field(OP *op, const char *type)
+{
+	const char *p;
+	int bits;
+
+	p = type;
+	bits = 0;
+	op->type = *p++;
+	switch (op->type) {
+	case T_UNSIGNED:
+	case T_SIGNED:
+		while (isdigit(*p)) bits = bits * 10 + *p++ - '0';
+		if (bits != 8 && bits != 16 && bits != 32 && bits != 64) return -1;
+		break;
+
+	case T_FLOAT:
+		while (isdigit(*p)) bits = bits * 10 + *p++ - '0';
+		if (bits != 32 && bits != 64) return -1;
+		break;
+
+	case T_CHAR:
+	case T_HEX:
+		bits = 8;
 		break;
+
+	default:
+		return -1;
+	}
+	op->size = bits / 8;
+
+	op->le = native_le();
+	     if (strncmp(p, "le", 2) == 0) { op->le = 1; p += 2; }
+	else if (strncmp(p, "be", 2) == 0) { op->le = 0; p += 2; }
+
+	op->count = 1;
+	if (*p == '[') {
+		op->count = 0;
+		for (p++; isdigit(*p); p++) op->count = op->count * 10 + *p - '0';
+		if (*p++ != ']' || op->count == 0) return -1;
+	}
+	return *p ? -1 : 0;
+}
+
+/* struct NAME TYPE FIELD [@OFFSET] */
+int parse_struct(CONFIG *c, char *s)
+{
+	char *name, *type, *field, *at, *end;
+	STRUCTDEF *def;
+	OP *op;
+	int i;
+
+	name  = strtok(s,    " \t");
+	type  = strtok(NULL, " \t");
+	field = strtok(NULL, " \t");
+	at    = strtok(NULL, " \t");
+	if (!field || strtok(NULL, " \t")) return -1;
+
+	def = NULL;
+	for (i = 0; i < c->nstructs; i++) {
+		if (strcmp(c->structs[i].name, name) == 0) def = &c->structs[i];
+	}
+	if (!def) {
+		c->structs = arena_grow(c->arena, c->structs, c->nstructs * sizeof(STRUCTDEF),
+		                        (c->nstructs + 1) * sizeof(STRUCTDEF));
+		if (!c->structs) return -1;
+		def = &c->structs[c->nstructs++];
+		def->name = arena_strdup(c->arena, name);
+	}
+
+	def->ops = arena_grow(c->arena, def->ops, def->nops * sizeof(OP), (def->nops + 1) * sizeof(OP));
+	if (!def->ops) return -1;
+	op = &def->ops[def->nops];
+
+	if (compile_field(op, type) != 0) return -1;
+	if (def->nops > 0) { /* packed after the previous field */
+		op->offset = op[-1].offset + op[-1].size * op[-1].count;
+	}
+	if (at) {
+		if (*at != '@') return -1;
+		op->offset = strtoul(at + 1, &end, 0);
+		if (*end) return -1;
+	}
+	op->name = arena_strdup(c->arena, field);
+	def->nops++;
+
+	if (op->offset + op->size * op->count > def->size) {
+		def->size = op->offset + op->size * op->count;
+	}
+	return 0;
+}
+
+static void decode_op(OP *op, const uint8_t *p, char *buf, size_t n)
+{
+	uint64_t v;
+	uint32_t i;
+	int k, shift;
+	union { uint32_t u; float f; } f32;
+	union { uint64_t u; double f; } f64;
+
+	k = 0;
+	if (op->type == T_CHAR) {
+		buf[k++] = '"';
+		for (i = 0; i < op->count && k < n - 2; i++) {
+			buf[k++] = (p[i] < 32 || p[i] > 126) ? '.' : p[i];
+		}
+		buf[k++] = '"';
+		buf[k] = '\0';
+		return;
+	}
+
+	if (op->count > 1 && op->type != T_HEX) k += snprintf(buf + k, n - k, "[");
+	for (i = 0; i < op->count && k < n; i++, p += op->size) {
+		if (i != 0) k += snprintf(buf + k, n - k, op->type == T_HEX ? " " : ", ");
+		if (k >= n) break;
+
+		v = peek_uint(p, op->size, op->le);
+		switch (op->type) {
+		case T_UNSIGNED:
+			k += snprintf(buf + k, n - k, "%lu", v);
+			break;
+
+		case T_SIGNED:
+			shift = 64 - 8 * op->size;
+			k += snprintf(buf + k, n - k, "%li", (int64_t)(v << shift) >> shift);
+			break;
+
+		case T_FLOAT:
+			if (op->size == 4) { f32.u = v; k += snprintf(buf + k, n - k, "%g", f32.f); }
+			else               { f64.u = v; k += snprintf(buf + k, n - k, "%g", f64.f); }
+			break;
+
+		case T_HEX:
+			k += snprintf(buf + k, n - k, "%02lx", v);
+			break;
+		}
+	}
+	if (op->count > 1 && op->type != T_HEX && k < n) snprintf(buf + k, n - k, "]");
+}
+
+/* runs the decode program for the record at the cursor; the results
+   are cached, so that redraws that don't move the cursor are free. */
+void decode(LAYOUT *l)
+{
+	STRUCTDEF *def;
+	size_t at;
+	int i;
+
+	at = l->offset + l->pos;
+	if (l->record < 0 || at == l->decoded_at) return;
+
+	def = &l->structs[l->record];
+	lpin(l, at, def->size);
+	for (i = 0; i < def->nops; i++) {
+		if (at + def->ops[i].offset + def->ops[i].size * def->ops[i].count > l->len) {
+			strcpy(l->decoded + i * DECODED_MAX, "-");
+			continue;
+		}
+		decode_op(&def->ops[i], l->data + at + def->ops[i].offset,
+		          l->decoded + i * DECODED_MAX, DECODED_MAX);
+	}
+	lunpin(l, at, def->size);
+	l->decoded_at = at;
+}
+
+void recpanel(LAYOUT *l)
+{
+	STRUCTDEF *def;
+	int i, w, cols;
+
+	if (!l->panel) return;
+	decode(l);
+
+	def = &l->structs[l->record];
+	cols = getmaxx(l->panel);
+	w = 0;
+	for (i = 0; i < def->nops; i++) {
+		w = max(w, strlen(def->ops[i].name));
+	}
+
+	werase(l->panel);
+	wattron(l->panel, A_BOLD);
+	mvwprintw(l->panel, 0, 0, "%.*s @%lu", cols, def->name, l->decoded_at);
+	wattroff(l->panel, A_BOLD);
+	for (i = 0; i < def->nops && i + 1 < l->main_height; i++) {
+		mvwprintw(l->panel, i + 1, 0, "%-*s %.*s", w, def->ops[i].name,
+		          max(cols - w - 1, 0), l->decoded + i * DECODED_MAX);
+	}
+	wnoutrefresh(l->panel);
+}
+
+/* show struct n in the record panel, or hide the panel (n < 0) */
+int lrecord(LAYOUT *l, int n)
+{
+	if (l->panel) {
+		werase(l->panel);
+		wnoutrefresh(l->panel);
+		delwin(l->panel);
+		l->panel = NULL;
+	}
+	free(l->decoded);
+	l->decoded = NULL;
+	l->decoded_at = (size_t)-1;
+	l->record = -1;
+	if (n < 0) return 0;
+
+	if (COLS - l->panel_x < 16) {
+		errno = ENOSPC;
+		return -1;
+	}
+	l->decoded = calloc(l->structs[n].nops, DECODED_MAX);
+	if (!l->decoded) return -1;
+
+	l->panel = newwin(l->main_height, COLS - l->panel_x, 0, l->panel_x);
+	l->record = n;
+	return 0;
+}
+/* }}} */
+/* configuration functions {{{ */
+FILE *find_config()
+{
+	FILE *io;
+	char *env, path[8192];
+	int n;
+
+	env = getenv("VEXRC");
+	if (env) {
+		io = fopen(env, "r");
+		if (io) return io;
+	}
+
+	env = getenv("HOME");
+	if (env) {
+		n = snprintf(path, 8192, "%s/" CONFIG_USERFILE, env);
+		if (n < 8192) {
+			io = fopen(path, "r");
+			if (io) return io;
+		}
+	}
+
+	return fopen(CONFIG_SYSFILE, "r");
+}
+
+#define DEFAULT_LAYOUT "Xa"
+#define DEFAULT_WIDTH  16
+#define DEFAULT_STATUS "vex [%1E] +%o/%l %F ... b[ %64b ]"
+
+CONFIG* configure()
+{
+	FILE *io;
+	CONFIG *c;
+	ARENA *arena;
+	char buf[8192];
+	int line;
+
+	arena = arena_new();
+	c = arena ? arena_alloc(arena, sizeof(CONFIG)) : NULL;
+	if (!c) {
+		printw("memory allocation failed while configuring.\n");
+		anyexit(1);
+	}
+	c->arena = arena;
+	c->width = DEFAULT_WIDTH;
+	c->prefetch = PF_HINT;
+	io = find_config();
+	if (!io) {
+		c->layout = arena_strdup(arena, DEFAULT_LAYOUT);
+		c->status = arena_strdup(arena, DEFAULT_STATUS);
+		return c;
+	}
+
+	line = 0;
+	while (fgets(buf, 8192, io) != NULL) {
+		char *a, *b;
+
+		line++;
+
+		a = strchr(buf, '\n');
+		if (a) *a = '\0';
+
+		for (a = &buf[0];  isspace(*a); a++);
+		if (!*a || *a == '#') continue;
+		for (b = a;       !isspace(*b); b++);
+		*b++ = '\0';
+
+		if (strcmp(a, "layout") == 0) {
+			for (a = b; isspace(*a); a++);
+			c->layout = arena_strdup(arena, a);
+			continue;
+		}
+		if (strcmp(a, "status") == 0) {
+			for (a = b; isspace(*a); a++);
+			if (c->status && strlen(c->status) > 0) {
+				b = arena_alloc(arena, strlen(c->status) + 1 + strlen(a) + 1);
+				if (!b) {
+					printw("memory allocation failed while configuring statusbar.\n");
+					anyexit(1);
+				}
+				sprintf(b, "%s\n%s", c->status, a);
+				c->status = b;
+
+			} else {
+				c->status = arena_strdup(arena, a);
+				if (!c->status) {
+					printw("memory allocation failed while configuring statusbar.\n");
+					anyexit(1);
+				}
+			}
+			continue;
+		}
+		if (strcmp(a, "width") == 0) {
+			c->width = strtol(b, &a, 0);
+			for (; isspace(*a); a++);
+			if (*a || c->width < 1) {
+				printw("Invalid width on line %d\n", line);
+				anyexit(1);
+			}
+			continue;
+		}
+		if (strcmp(a, "budget") == 0) {
+			uint64_t v;
+
+			if (parse_size(b, &v) != 0) {
+				printw("Invalid budget on line %d (want a size, like 512M)\n", line);
+				anyexit(1);
+			}
+			c->budget = v;
+			continue;
+		}
+		if (strcmp(a, "prefetch") == 0) {
+			for (a = b; isspace(*a); a++);
+			for (b = a; *b && !isspace(*b); b++);
+			*b = '\0';
+			     if (strcmp(a, "off")    == 0) c->prefetch = PF_OFF;
+			else if (strcmp(a, "on")     == 0) c->prefetch = PF_HINT;
+			else if (strcmp(a, "thread") == 0) c->prefetch = PF_THREAD;
+			else {
+				printw("Invalid prefetch mode on line %d (want off, on or thread)\n", line);
+				anyexit(1);
+			}
+			continue;
+		}
+		if (strcmp(a, "struct") == 0) {
+			for (a = b; isspace(*a); a++);
+			if (parse_struct(c, a) != 0) {
+				printw("Invalid struct field on line %d\n", line);
+				anyexit(1);
+			}
+			continue;
+		}
+
+		printw("Invalid configuration on line %d: '%s'\n", line, buf);
+		anyexit(1);
+	}
+
+	fclose(io);
+
+	if (!c->layout) c->layout = arena_strdup(arena, DEFAULT_LAYOUT);
+	if (!c->status) c->status = arena_strdup(arena, DEFAULT_STATUS);
+	return c;
+}
+
+static uint8_t * mapfile(const char *path, size_t *len, int *_fd)
+{
+	int fd;
+	void *addr;
+
+	if (!len) {
+		printw("BUG: mapfile() called with NULL len argument.\n");
+		anyexit(1);
+	}
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		printw("ERROR: %s\n", strerror(errno));
+		anyexit(1);
+	}
+
+	*len = lseek(fd, 0, SEEK_END);
+	addr = mmap(NULL, *len, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (addr == MAP_FAILED) {
+		printw("ERROR: %s\n", strerror(errno));
+		anyexit(1);
+	}
+
+	*_fd = fd;
+	return addr;
+}
+
+int lopen(LAYOUT *l, const char *path, int raw)
+{
+	int fd;
+
+	l->data = mapfile(path, &(l->len), &fd);
+	if (!l->data) return 0; /* failed */
+	l->fd = fd;
+
+	if (!raw && l->len >= 6) {
+		if (l->data[0] == 0x1f && l->data[1] == 0x8b) {
+			l->src = gz_open(path, l->data, l->len);
+		} else if (memcmp(l->data, "\xfd" "7zXZ\0", 6) == 0) {
+			l->src = xz_open(l->data, l->len);
+		}
+		if (l->src) {
+			l->data = l->src->base;
+			l->len  = l->src->len;
+		}
+	}
+	if (!l->src && l->budget && l->len > l->budget) {
+		l->src = file_open(fd, l->len);
+		if (l->src) {
+			munmap(l->data, l->len);
+			l->data = l->src->base;
+		}
+	}
+	if (l->src && l->budget) {
+		l->src->budget = max(l->budget / SRC_CHUNK, 2);
+	}
+	if (!l->src || l->src->fill == file_fill) lextents(l, path);
+
+	l->path = strdup(path);
+	l->file = strrchr(l->path, '/');
+	if (l->file) l->file++;
+	else l->file = l->path;
+	return 1;
+}
+/* }}} */
+
+/* opens the address space of a running process; see proc_open() */
+int lopen_pid(LAYOUT *l, pid_t pid)
+{
+	char path[64], comm[64];
+	FILE *io;
+
+	l->src = proc_open(pid);
+	if (!l->src) {
+		printw("ERROR: process %d: %s\n", (int)pid, strerror(errno));
+		return 0;
+	}
+	if (l->budget) l->src->budget = max(l->budget / SRC_CHUNK, 2);
+	l->data = l->src->base;
+	l->len  = l->src->len;
+	l->fd   = -1;
+
+	strcpy(comm, "?");
+	snprintf(path, sizeof(path), "/proc/%d/comm", (int)pid);
+	if ((io = fopen(path, "r")) != NULL) {
+		if (fgets(comm, sizeof(comm), io)) comm[strcspn(comm, "\n")] = '\0';
+		fclose(io);
+	}
+	snprintf(path, sizeof(path), "/proc/%d/mem", (int)pid);
+	l->path = strdup(path);
+	snprintf(path, sizeof(path), "%s[%d]", comm, (int)pid);
+	l->file = strdup(path);
+	return 1;
+}
+
+/* table view {{{ */
+#define TABLE_FOOTER 3
+#define AGG_BLOCK 1024
+#define AGG_BIAS  0x8000000000000000ULL
+
+typedef int64_t vi64 __attribute__((vector_size(32)));
+typedef double  vf64 __attribute__((vector_size(32)));
+#define VLANES (sizeof(vi64) / sizeof(int64_t))
+
+/* vectorized min / max / sum over a block of gathered integer values;
+   u64 values come in biased by 2^63, so that signed compares work. */
+static void agg_ints(AGG *a, const int64_t *iv, const double *fv, size_t n)
+{
+	vi64 lo, hi, x, m;
+	vf64 sum, f;
+	size_t i, k;
+
+	for (k = 0; k < VLANES; k++) {
+		lo[k] = a->imin;
+		hi[k] = a->imax;
+		sum[k] = 0;
+	}
+	for (i = 0; i + VLANES <= n; i += VLANES) {
+		memcpy(&x, iv + i, sizeof(x));
+		memcpy(&f, fv + i, sizeof(f));
+		m = x < lo; lo = (x & m) | (lo & ~m);
+		m = x > hi; hi = (x & m) | (hi & ~m);
+		sum += f;
+	}
+	for (k = 0; k < VLANES; k++) {
+		if (lo[k] < a->imin) a->imin = lo[k];
+		if (hi[k] > a->imax) a->imax = hi[k];
+		a->sum += sum[k];
+	}
+	for (; i < n; i++) {
+		if (iv[i] < a->imin) a->imin = iv[i];
+		if (iv[i] > a->imax) a->imax = iv[i];
+		a->sum += fv[i];
+	}
+	a->n += n;
+}
+
+static void agg_floats(AGG *a, const double *fv, size_t n)
+{
+	vf64 lo, hi, x, sum;
+	vi64 m;
+	size_t i, k;
+
+	for (k = 0; k < VLANES; k++) {
+		lo[k] = a->fmin;
+		hi[k] = a->fmax;
+		sum[k] = 0;
+	}
+	for (i = 0; i + VLANES <= n; i += VLANES) {
+		memcpy(&x, fv + i, sizeof(x));
+		m = x < lo; lo = (vf64)(((vi64)x & m) | ((vi64)lo & ~m));
+		m = x > hi; hi = (vf64)(((vi64)x & m) | ((vi64)hi & ~m));
+		sum += x;
+	}
+	for (k = 0; k < VLANES; k++) {
+		if (lo[k] < a->fmin) a->fmin = lo[k];
+		if (hi[k] > a->fmax) a->fmax = hi[k];
+		a->sum += sum[k];
+	}
+	for (; i < n; i++) {
+		if (fv[i] < a->fmin) a->fmin = fv[i];
+		if (fv[i] > a->fmax) a->fmax = fv[i];
+		a->sum += fv[i];
+	}
+	a->n += n;
+}
+
+/* the background aggregation pass: gathers each numeric field for a
+   block of records into a flat buffer, and reduces that with SIMD. */
+static void *aggregate(void *_)
+{
+	TABLE *t;
+	OP *op;
+	AGG *acc;
+	int64_t *iv;
+	double *fv;
+	const uint8_t *p;
+	size_t r, n, i, j, k, most;
+	uint64_t v;
+	int o, shift;
+	union { uint32_t u; float f; } f32;
+	union { uint64_t u; double f; } f64;
+
+	t = (TABLE *)_;
+	most = 1;
+	for (o = 0; o < t->def->nops; o++) {
+		most = max(most, t->def->ops[o].count);
+	}
+	acc = calloc(t->def->nops, sizeof(AGG));
+	iv  = calloc(AGG_BLOCK * most, sizeof(int64_t));
+	fv  = calloc(AGG_BLOCK * most, sizeof(double));
+	if (!acc || !iv || !fv) goto done;
+
+	for (o = 0; o < t->def->nops; o++) {
+		acc[o].imin = INT64_MAX; acc[o].fmin =  HUGE_VAL;
+		acc[o].imax = INT64_MIN; acc[o].fmax = -HUGE_VAL;
+	}
+
+	t->job.total = t->nrec;
+	for (r = 0; r < t->nrec && !t->job.cancel; r += n) {
+		n = min(AGG_BLOCK, t->nrec - r);
+		if (t->src) src_pin(t->src, t->base + r * t->stride, (n - 1) * t->stride + t->def->size);
+		for (o = 0; o < t->def->nops; o++) {
+			op = &t->def->ops[o];
+			if (op->type != T_UNSIGNED && op->type != T_SIGNED && op->type != T_FLOAT) continue;
+
+			shift = 64 - 8 * op->size;
+			k = 0;
+			for (i = 0; i < n; i++) {
+				p = t->data + t->base + (r + i) * t->stride + op->offset;
+				for (j = 0; j < op->count; j++, p += op->size, k++) {
+					v = peek_uint(p, op->size, op->le);
+					switch (op->type) {
+					case T_UNSIGNED:
+						iv[k] = op->size == 8 ? (int64_t)(v ^ AGG_BIAS) : (int64_t)v;
+						fv[k] = (double)v;
+						break;
+
+					case T_SIGNED:
+						iv[k] = (int64_t)(v << shift) >> shift;
+						fv[k] = (double)iv[k];
+						break;
+
+					case T_FLOAT:
+						if (op->size == 4) { f32.u = v; fv[k] = f32.f; }
+						else               { f64.u = v; fv[k] = f64.f; }
+						break;
+					}
+				}
+			}
+			if (op->type == T_FLOAT) agg_floats(&acc[o], fv, k);
+			else                     agg_ints(&acc[o], iv, fv, k);
+		}
+		if (t->src) src_unpin(t->src, t->base + r * t->stride, (n - 1) * t->stride + t->def->size);
+
+		pthread_mutex_lock(&t->lock);
+		memcpy(t->agg, acc, t->def->nops * sizeof(AGG));
+		pthread_mutex_unlock(&t->lock);
+		t->job.progress = r + n;
+	}
+
+done:
+	free(acc);
+	free(iv);
+	free(fv);
+	t->job.done = 1;
+	return NULL;
+}
+
+static int colwidth(OP *op)
+{
+	int w;
+
+	switch (op->type) {
+	case T_CHAR:  w = op->count + 2;     break;
+	case T_HEX:   w = op->count * 3 - 1; break;
+	case T_FLOAT: w = 12;                break;
 	default:
-		wprintw(l->status, "!!!");
+		w = op->size == 1 ? 3 : op->size == 2 ? 5 : op->size == 4 ? 10 : 20;
+		if (op->type == T_SIGNED) w++;
+		if (op->count > 1) w = op->count * (w + 2);
 		break;
 	}
-} /* }}} */
-static void fmt_b(void *_, int width, void *_field) /* {{{ */
+	w = min(w, 32);
+	return max(w, strlen(op->name));
+}
+
+static void aggfmt(OP *op, AGG *a, int which, char *buf, size_t n, int width)
+{
+	int prec;
+
+	if (a->n == 0 || op->type == T_CHAR || op->type == T_HEX) {
+		snprintf(buf, n, "%s", a->n ? "" : "-");
+		return;
+	}
+	if (which == 2) {
+		/* trade precision for fitting in the column */
+		for (prec = 6; prec > 1; prec--) {
+			if (snprintf(buf, n, "%.*g", prec, a->sum) <= width) break;
+		}
+
+	} else if (op->type == T_FLOAT) {
+		snprintf(buf, n, "%g", which == 0 ? a->fmin : a->fmax);
+
+	} else if (op->type == T_UNSIGNED && op->size == 8) {
+		snprintf(buf, n, "%lu", (uint64_t)((which == 0 ? a->imin : a->imax) ^ AGG_BIAS));
+
+	} else {
+		snprintf(buf, n, "%li", which == 0 ? a->imin : a->imax);
+	}
+}
+
+static void tcell(WINDOW *w, int y, int x, int width, const char *s, int right)
+{
+	int room;
+
+	room = min(width, getmaxx(w) - x);
+	if (room <= 0) return;
+	mvwprintw(w, y, x, right ? "%*.*s" : "%-*.*s", room, room, s);
+}
+
+/* draws the table view; only the records that are on screen are decoded */
+void tdraw(LAYOUT *l)
+{
+	static const char *labels[TABLE_FOOTER] = { "min", "max", "sum" };
+	TABLE *t;
+	OP *op;
+	char buf[DECODED_MAX];
+	const uint8_t *p;
+	size_t r;
+	int o, x, y, rows, iw, right;
+
+	t = l->table;
+	lgoto(l, t->base + t->rec * t->stride);
+
+	rows = l->main_height - 2 - TABLE_FOOTER;
+	if (rows < 1) rows = 1;
+	if (t->rec < t->top)         t->top = t->rec;
+	if (t->rec >= t->top + rows) t->top = t->rec - rows + 1;
+
+	iw = max(snprintf(NULL, 0, "%zu", t->nrec), 3);
+	lpin(l, t->base + t->top * t->stride, rows * t->stride + t->def->size);
+
+	werase(t->win);
+	wattron(t->win, A_BOLD);
+	tcell(t->win, 0, 0, iw, "#", 1);
+	for (x = iw + 2, o = 0; o < t->def->nops; x += t->widths[o++] + 2) {
+		tcell(t->win, 0, x, t->widths[o], t->def->ops[o].name, 0);
+	}
+	if (!t->job.done && t->job.total) {
+		snprintf(buf, sizeof(buf), " [%zu%%]", t->job.progress * 100 / t->job.total);
+		tcell(t->win, 0, x, strlen(buf), buf, 0);
+	}
+	wattroff(t->win, A_BOLD);
+
+	for (y = 0; y < rows && t->top + y < t->nrec; y++) {
+		r = t->top + y;
+		p = t->data + t->base + r * t->stride;
+
+		if (r == t->rec) wattron(t->win, C_CURSOR);
+		snprintf(buf, sizeof(buf), "%zu", r);
+		tcell(t->win, y + 1, 0, iw, buf, 1);
+		for (x = iw + 2, o = 0; o < t->def->nops; x += t->widths[o++] + 2) {
+			op = &t->def->ops[o];
+			right = op->type != T_CHAR && op->type != T_HEX && op->count == 1;
+			decode_op(op, p + op->offset, buf, sizeof(buf));
+			tcell(t->win, y + 1, x, t->widths[o], buf, right);
+		}
+		if (r == t->rec) wattroff(t->win, C_CURSOR);
+	}
+	lunpin(l, t->base + t->top * t->stride, rows * t->stride + t->def->size);
+
+	pthread_mutex_lock(&t->lock);
+	for (y = 0; y < TABLE_FOOTER; y++) {
+		wattron(t->win, A_BOLD);
+		tcell(t->win, rows + 1 + y, 0, iw, labels[y], 1);
+		wattroff(t->win, A_BOLD);
+		for (x = iw + 2, o = 0; o < t->def->nops; x += t->widths[o++] + 2) {
+			aggfmt(&t->def->ops[o], &t->agg[o], y, buf, sizeof(buf), t->widths[o]);
+			tcell(t->win, rows + 1 + y, x, t->widths[o], buf, 1);
+		}
+	}
+	pthread_mutex_unlock(&t->lock);
+
+	wnoutrefresh(t->win);
+}
+
+void ltable_close(LAYOUT *l)
+{
+	TABLE *t;
+
+	t = l->table;
+	if (!t) return;
+
+	job_stop(&t->job);
+	lgoto(l, t->base + t->rec * t->stride);
+
+	werase(t->win);
+	wnoutrefresh(t->win);
+	delwin(t->win);
+	pthread_mutex_destroy(&t->lock);
+	free(t->widths);
+	free(t->agg);
+	free(t);
+	l->table = NULL;
+}
+
+/* switch to the table view of `def` records, starting at the cursor */
+int ltable(LAYOUT *l, STRUCTDEF *def, size_t stride)
+{
+	TABLE *t;
+	size_t at;
+	int i;
+
+	ltable_close(l);
+
+	at = l->offset + l->pos;
+	if (stride == 0) stride = def->size;
+	if (def->size == 0 || l->len - at < def->size) {
+		errno = ERANGE;
+		return -1;
+	}
+
+	t = calloc(1, sizeof(TABLE));
+	if (!t) return -1;
+
+	t->def    = def;
+	t->base   = at;
+	t->stride = stride;
+	t->nrec   = (l->len - at - def->size) / stride + 1;
+	t->data   = l->data;
+	t->src    = l->src;
+	t->widths = calloc(def->nops, sizeof(int));
+	t->agg    = calloc(def->nops, sizeof(AGG));
+	if (!t->widths || !t->agg) {
+		free(t->widths);
+		free(t->agg);
+		free(t);
+		return -1;
+	}
+	for (i = 0; i < def->nops; i++) {
+		t->widths[i] = colwidth(&def->ops[i]);
+	}
+
+	pthread_mutex_init(&t->lock, NULL);
+	t->win = newwin(l->main_height - 1, COLS, 0, 0);
+	l->table = t;
+
+	if (job_start(&t->job, aggregate, t) != 0) {
+		ltable_close(l);
+		return -1;
+	}
+	return 0;
+}
+/* }}} */
+/* strings {{{ */
+/* The strings pass finds runs of printable ASCII, and of printable
+   ASCII encoded as UTF-16 (either endianness), at least `min`
+   characters long.  The image is split into one slice per CPU; each
+   worker reports the runs that start in its slice (reading past its
+   end to finish the last one), and the slices are stitched back
+   together in order.  Octets are classified 32 at a time, and runs of
+   ASCII are followed through the resulting bit masks; only octets that
+   might be UTF-16 are looked at one by one. */
+#define STR_BLOCK   SRC_CHUNK
+#define STR_THREADS 16
+#define STR_NONE    ((size_t)-1)
+#define STR_PAD     64 /* of a hole's zeros, which end any run */
+#define PRINTABLE(c) (((c) >= 0x20 && (c) < 0x7f) || (c) == '\t')
+
+typedef uint8_t vu8 __attribute__((vector_size(32)));
+
+typedef struct {
+	STRINGS *s;
+	size_t from, to;     /* report the runs starting in [from, to) */
+	size_t n, cap;
+	uint64_t *off;
+	uint32_t *len;
+	pthread_t tid;
+} STRSLICE;
+
+/* bit masks of which of the 32 octets at p are printable, and zero */
+static void str_classify(const uint8_t *p, uint32_t *printable, uint32_t *zero)
+{
+	vu8 v, pm, zm;
+	uint64_t q[4], z[4];
+	int k;
+
+	memcpy(&v, p, sizeof(v));
+	pm = ((vu8)(v - 0x20 < 0x5f) | (vu8)(v == '\t')) & 1;
+	zm = (vu8)(v == 0) & 1;
+	memcpy(q, &pm, sizeof(q));
+	memcpy(z, &zm, sizeof(z));
+
+	/* gather the low bit of each octet into one bit per octet */
+	*printable = *zero = 0;
+	for (k = 0; k < 4; k++) {
+		*printable |= (uint32_t)((q[k] * 0x0102040810204080ULL) >> 56) << (8 * k);
+		*zero      |= (uint32_t)((z[k] * 0x0102040810204080ULL) >> 56) << (8 * k);
+	}
+}
+
+static void str_emit(STRSLICE *w, size_t off, size_t n, int enc)
+{
+	void *p;
+	size_t cap;
+
+	if (n < (size_t)w->s->min || off < w->from || off >= w->to) return;
+	if (w->n == w->cap) {
+		cap = w->cap ? w->cap * 2 : 4096;
+		if (!(p = realloc(w->off, cap * sizeof(uint64_t)))) return;
+		w->off = p;
+		if (!(p = realloc(w->len, cap * sizeof(uint32_t)))) return;
+		w->len = p;
+		w->cap = cap;
+	}
+	w->off[w->n] = off;
+	w->len[w->n] = (uint32_t)enc << 30 | min(n, STR_MAXLEN);
+	w->n++;
+}
+
+static int offcmp(const void *a, const void *b)
+{
+	return *(const uint64_t *)a < *(const uint64_t *)b ? -1
+	     : *(const uint64_t *)a > *(const uint64_t *)b;
+}
+
+static void *str_slice(void *_)
+{
+	STRSLICE *w;
+	STRINGS *s;
+	PINWIN pw;
+	const uint8_t *p;
+	size_t i, i0, end, hole, a, le[2], be[2], k, *order;
+	uint64_t *off;
+	uint32_t *len, pm, zm, u, bits;
+	int c, d, par, owned, lim;
+
+	w = (STRSLICE *)_;
+	s = w->s;
+	p = s->data;
+	memset(&pw, 0, sizeof(pw));
+	pw.src = s->src;
+
+	/* runs already under way at `from` belong to the previous slice;
+	   starting them early keeps them from being reported here */
+	pw_need(&pw, w->from ? w->from - 2 : 0, STR_BLOCK);
+	a = le[0] = le[1] = be[0] = be[1] = STR_NONE;
+	if (w->from >= 1 && PRINTABLE(p[w->from - 1])) a = w->from - 1;
+	for (k = 1; k <= 2 && k <= w->from; k++) {
+		par = (w->from - k) & 1;
+		if (PRINTABLE(p[w->from - k]) && p[w->from - k + 1] == 0) le[par] = w->from - k;
+		if (p[w->from - k] == 0 && PRINTABLE(p[w->from - k + 1])) be[par] = w->from - k;
+	}
+
+	for (i = w->from; i < s->size && !s->job.cancel; ) {
+		i0  = i;
+		i   = min(ext_next(s->ext, s->nextents, i, STR_PAD, &hole), s->size);
+		if (i > i0 && i >= w->to) { /* only a hole left, and no runs open */
+			__atomic_fetch_add(&s->job.progress, w->to - min(i0, w->to), __ATOMIC_RELAXED);
+			break;
+		}
+		end = min(min((i / STR_BLOCK + 1) * STR_BLOCK, s->size), hole);
+		pw_need(&pw, i, end - i + 64);
+
+		while (i < end) {
+			if (i + 32 < s->size && (le[0] & le[1] & be[0] & be[1]) == STR_NONE) {
+				/* with no UTF-16 runs open, only ASCII runs need
+				   following, up to the first octet that could begin
+				   a UTF-16 character.  The last octet of a vector
+				   needs the one after it, so that's left for later. */
+				str_classify(p + i, &pm, &zm);
+				u = ((pm & zm >> 1) | (zm & pm >> 1)) | 0x80000000;
+				lim = __builtin_ctz(u);
+				for (k = 0; k < lim; ) {
+					bits = (a == STR_NONE ? pm : ~pm) >> k & ((1u << lim) - 1) >> k;
+					if (!bits) break;
+					k += __builtin_ctz(bits);
+					if (a == STR_NONE) {
+						a = i + k;
+					} else {
+						str_emit(w, a, i + k - a, STR_ASCII);
+						a = STR_NONE;
+					}
+				}
+				i += lim;
+				if (lim) continue;
+			}
+
+			c = p[i];
+			d = i + 1 < s->size ? p[i + 1] : 0xff;
+			par = i & 1;
+
+			if (PRINTABLE(c)) {
+				if (a == STR_NONE) a = i;
+			} else if (a != STR_NONE) {
+				str_emit(w, a, i - a, STR_ASCII);
+				a = STR_NONE;
+			}
+
+			if (PRINTABLE(c) && d == 0) {
+				if (le[par] == STR_NONE) le[par] = i;
+			} else if (le[par] != STR_NONE) {
+				str_emit(w, le[par], (i - le[par]) / 2, STR_LE);
+				le[par] = STR_NONE;
+			}
+
+			if (c == 0 && PRINTABLE(d)) {
+				if (be[par] == STR_NONE) be[par] = i;
+			} else if (be[par] != STR_NONE) {
+				str_emit(w, be[par], (i - be[par]) / 2, STR_BE);
+				be[par] = STR_NONE;
+			}
+			i++;
+		}
+		if (i0 < w->to) __atomic_fetch_add(&s->job.progress, min(i, w->to) - i0, __ATOMIC_RELAXED);
+
+		/* past the end of the slice, keep going only to finish the
+		   runs that started inside it */
+#define OWNED(x) ((x) != STR_NONE && (x) >= w->from && (x) < w->to)
+		owned = OWNED(a) || OWNED(le[0]) || OWNED(le[1]) || OWNED(be[0]) || OWNED(be[1]);
+#undef OWNED
+		if (i >= w->to && !owned) break;
+	}
+	if (i >= s->size) {
+		if (a != STR_NONE) str_emit(w, a, s->size - a, STR_ASCII);
+		for (par = 0; par < 2; par++) {
+			if (le[par] != STR_NONE) str_emit(w, le[par], (s->size - le[par]) / 2, STR_LE);
+			if (be[par] != STR_NONE) str_emit(w, be[par], (s->size - be[par]) / 2, STR_BE);
+		}
+	}
+	pw_done(&pw);
+
+	/* runs are reported as they end, not as they start */
+	order = malloc(w->n * sizeof(size_t) * 2);
+	off   = malloc(w->n * sizeof(uint64_t));
+	len   = malloc(w->n * sizeof(uint32_t));
+	if (order && off && len) {
+		for (k = 0; k < w->n; k++) {
+			order[2 * k]     = w->off[k];
+			order[2 * k + 1] = w->len[k];
+		}
+		qsort(order, w->n, 2 * sizeof(size_t), offcmp);
+		for (k = 0; k < w->n; k++) {
+			off[k] = order[2 * k];
+			len[k] = order[2 * k + 1];
+		}
+		free(w->off); w->off = off;
+		free(w->len); w->len = len;
+	} else {
+		free(off);
+		free(len);
+	}
+	free(order);
+	return NULL;
+}
+
+static size_t str_text(STRINGS *s, size_t i, char *buf, size_t n)
+{
+	const uint8_t *p;
+	size_t k, len;
+	int enc;
+
+	enc = STR_ENC(s->len[i]);
+	len = min(STR_LEN(s->len[i]), n);
+	p   = s->data + s->off[i] + (enc == STR_BE);
+	for (k = 0; k < len; k++) {
+		buf[k] = p[enc == STR_ASCII ? k : 2 * k];
+	}
+	return len;
+}
+
+static size_t str_bytes(STRINGS *s, size_t i)
+{
+	return STR_LEN(s->len[i]) * (STR_ENC(s->len[i]) == STR_ASCII ? 1 : 2);
+}
+
+/* case-insensitive substring match of the filter */
+static int str_match(STRINGS *s, size_t i, const char *f, size_t flen)
+{
+	const uint8_t *p;
+	size_t k, j, len, step;
+
+	len  = STR_LEN(s->len[i]);
+	step = STR_ENC(s->len[i]) == STR_ASCII ? 1 : 2;
+	p    = s->data + s->off[i] + (STR_ENC(s->len[i]) == STR_BE);
+	for (k = 0; k + flen <= len; k++) {
+		for (j = 0; j < flen && tolower(p[(k + j) * step]) == f[j]; j++);
+		if (j == flen) return 1;
+	}
+	return 0;
+}
+
+/* narrows the match list down to the strings containing s->filter;
+   when the previous filter finished and is contained in this one,
+   only its matches are looked at.  Matches are compacted in place,
+   and published as they are found. */
+static void *str_filter(void *_)
+{
+	STRINGS *s;
+	PINWIN pw;
+	size_t i, k, n, flen;
+	char f[STR_FILTER];
+
+	s = (STRINGS *)_;
+	memset(&pw, 0, sizeof(pw));
+	pw.src = s->src;
+
+	flen = strlen(s->filter);
+	for (k = 0; k < flen; k++) f[k] = tolower((unsigned char)s->filter[k]);
+
+	n = s->refine ? s->nmatch : s->n;
+	s->fjob.total = n;
+	s->nmatch = 0;
+	for (k = 0; k < n && !s->fjob.cancel; k++) {
+		i = s->refine ? s->match[k] : k;
+		if (flen) {
+			pw_need(&pw, s->off[i], str_bytes(s, i));
+			if (!str_match(s, i, f, flen)) continue;
+		}
+		s->match[s->nmatch] = i;
+		__atomic_store_n(&s->nmatch, s->nmatch + 1, __ATOMIC_RELEASE);
+		if ((k & 0xfff) == 0) s->fjob.progress = k;
+	}
+	pw_done(&pw);
+
+	s->filtered = !s->fjob.cancel;
+	s->fjob.done = 1;
+	return NULL;
+}
+
+/* (re)starts filtering, after s->filter changes from `old` */
+void str_refilter(STRINGS *s, const char *old)
+{
+	if (!s->job.done) { /* sdraw() will, once extraction is done */
+		s->stale = 1;
+		return;
+	}
+
+	job_stop(&s->fjob); /* a finished one is joined, too */
+	s->refine = s->filtered && strstr(s->filter, old) != NULL;
+	s->filtered = 0;
+	s->top = s->sel = 0;
+	if (job_start(&s->fjob, str_filter, s) != 0) s->fjob.done = 1;
+}
+
+static void *str_extract(void *_)
+{
+	STRINGS *s;
+	STRSLICE w[STR_THREADS];
+	size_t i, k, n, slice, total, a, b;
+	int nw;
+
+	s = (STRINGS *)_;
+	s->job.total = s->size;
+
+	nw = nworkers(STR_THREADS);
+	slice = (s->size / nw + STR_BLOCK) / STR_BLOCK * STR_BLOCK;
+	memset(w, 0, sizeof(w));
+	for (i = 0; i < nw; i++) {
+		w[i].s    = s;
+		w[i].from = min(i * slice, s->size);
+		w[i].to   = min((i + 1) * slice, s->size);
+		if (w[i].from == w[i].to || pthread_create(&w[i].tid, NULL, str_slice, &w[i]) != 0) {
+			w[i].to = w[i].from; /* nothing to join */
+		}
+	}
+	for (total = 0, i = 0; i < nw; i++) {
+		if (w[i].to > w[i].from) pthread_join(w[i].tid, NULL);
+		total += w[i].n;
+	}
+
+	s->off   = malloc(total * sizeof(uint64_t) + 1);
+	s->len   = malloc(total * sizeof(uint32_t) + 1);
+	s->match = malloc(total * sizeof(uint32_t) + 1);
+	if (s->off && s->len && s->match && !s->job.cancel) {
+		for (n = 0, i = 0; i < nw; i++) {
+			memcpy(s->off + n, w[i].off, w[i].n * sizeof(uint64_t));
+			memcpy(s->len + n, w[i].len, w[i].n * sizeof(uint32_t));
+			n += w[i].n;
+		}
+
+		/* UTF-16 text can be read both ways, one octet apart;
+		   keep whichever reading is longer (little endian on ties) */
+		for (k = 0; k + 1 < n; k++) {
+			a = STR_ENC(s->len[k]);
+			b = STR_ENC(s->len[k + 1]);
+			if (a == STR_ASCII || b == STR_ASCII || a == b) continue;
+			if (s->off[k + 1] >= s->off[k] + str_bytes(s, k)) continue;
+
+			if (STR_LEN(s->len[k]) > STR_LEN(s->len[k + 1])
+			 || (STR_LEN(s->len[k]) == STR_LEN(s->len[k + 1]) && a == STR_LE)) {
+				s->len[k + 1] &= ~STR_MAXLEN;
+			} else {
+				s->len[k] &= ~STR_MAXLEN;
+			}
+		}
+		for (s->n = 0, k = 0; k < n; k++) {
+			if (STR_LEN(s->len[k]) == 0) continue;
+			s->off[s->n] = s->off[k];
+			s->len[s->n] = s->len[k];
+			s->n++;
+		}
+	}
+	for (i = 0; i < nw; i++) {
+		free(w[i].off);
+		free(w[i].len);
+	}
+
+	/* everything matches the empty filter; anything typed in the
+	   meantime is applied by the next sdraw() */
+	for (k = 0; s->match && k < s->n; k++) {
+		s->match[k] = k;
+	}
+	s->nmatch   = s->n;
+	s->filtered = 1;
+	s->job.done = 1;
+	return NULL;
+}
+
+void lstrings_free(LAYOUT *l)
+{
+	STRINGS *s;
+
+	s = l->strings;
+	if (!s) return;
+
+	job_stop(&s->job);
+	job_stop(&s->fjob);
+	if (s->win) delwin(s->win);
+	free(s->off);
+	free(s->len);
+	free(s->match);
+	free(s);
+	l->strings = NULL;
+	if (l->pane == P_STRINGS) l->pane = P_NONE;
+}
+
+void lstrings_close(LAYOUT *l)
+{
+	STRINGS *s;
+
+	s = l->strings;
+	if (!s || l->pane != P_STRINGS) return;
+
+	s->editing = 0;
+	werase(s->win);
+	wnoutrefresh(s->win);
+	l->pane = P_NONE;
+}
+
+/* shows the strings pane, extracting strings of at least `min`
+   characters first, if that hasn't been done already */
+int lstrings(LAYOUT *l, int min)
+{
+	STRINGS *s;
+
+	if (l->table) ltable_close(l);
+	if (l->strings && l->strings->min != min) lstrings_free(l);
+
+	if (!l->strings) {
+		s = calloc(1, sizeof(STRINGS));
+		if (!s) return -1;
+		s->min  = min;
+		s->data = l->data;
+		s->src  = l->src;
+		s->ext  = l->extents;
+		s->nextents = l->nextents;
+		s->size = l->src ? l->src->len : l->len;
+		s->fjob.done = 1;
+		s->win  = newwin(l->main_height - 1, COLS, 0, 0);
+		l->strings = s;
+		if (job_start(&s->job, str_extract, s) != 0) {
+			lstrings_free(l);
+			return -1;
+		}
+	}
+	l->strings->home = l->offset + l->pos;
+	l->pane = P_STRINGS;
+	return 0;
+}
+
+void sdraw(LAYOUT *l)
+{
+	STRINGS *s;
+	size_t n, i, k, len;
+	int y, rows, x;
+	char buf[4096];
+
+	s = l->strings;
+	if (s->stale && s->job.done) {
+		s->stale = 0;
+		str_refilter(s, "");
+	}
+	rows = max(l->main_height - 2, 1);
+	n = __atomic_load_n(&s->nmatch, __ATOMIC_ACQUIRE);
+	if (!s->job.done) n = 0;
+	if (s->sel >= n) s->sel = n ? n - 1 : 0;
+	if (s->sel < s->top)         s->top = s->sel;
+	if (s->sel >= s->top + rows) s->top = s->sel - rows + 1;
+	if (n) lgoto(l, s->off[s->match[s->sel]]);
+
+	werase(s->win);
+	wattron(s->win, A_BOLD);
+	if (!s->job.done) {
+		mvwprintw(s->win, 0, 0, "extracting strings (min %d) [%zu%%]", s->min,
+			s->job.total ? s->job.progress * 100 / s->job.total : 0);
+	} else {
+		mvwprintw(s->win, 0, 0, "%zu of %zu strings (min %d)", n, s->n, s->min);
+		if (*s->filter || s->editing) wprintw(s->win, " matching /%s", s->filter);
+		if (!s->fjob.done && s->fjob.total) {
+			wprintw(s->win, " [%zu%%]", s->fjob.progress * 100 / s->fjob.total);
+		}
+	}
+	wattroff(s->win, A_BOLD);
+
+	for (y = 0; y < rows && s->top + y < n; y++) {
+		i = s->match[s->top + y];
+		lpin(l, s->off[i], str_bytes(s, i));
+		len = str_text(s, i, buf, min(sizeof(buf) - 1, COLS));
+		lunpin(l, s->off[i], str_bytes(s, i));
+		for (k = 0; k < len; k++) {
+			if (buf[k] == '\t') buf[k] = ' ';
+		}
+		buf[len] = '\0';
+
+		if (s->top + y == s->sel) wattron(s->win, C_CURSOR);
+		mvwprintw(s->win, y + 1, 0, "%10lx %s ", s->off[i],
+			STR_ENC(s->len[i]) == STR_LE ? "le" : STR_ENC(s->len[i]) == STR_BE ? "be" : "  ");
+		x = getcurx(s->win);
+		wprintw(s->win, "%.*s", max(COLS - x, 0), buf);
+		if (s->top + y == s->sel) wattroff(s->win, C_CURSOR);
+	}
+	wnoutrefresh(s->win);
+}
+
+/* }}} */
+/* signature scans {{{ */
+/* `:scan FILE` looks for every signature listed in FILE, one per line:
+
+       png   89 50 4e 47 0d 0a 1a 0a
+       zip   "PK" 03 04
+
+   The signatures are compiled into an Aho-Corasick automaton (a
+   complete DFA, one row of 256 transitions per state), so the image
+   is read once no matter how many signatures there are.  The pass is
+   split across CPUs; each worker starts its automaton maxlen - 1
+   octets before its slice, and keeps the hits that start inside it.
+   When only a few octets begin a signature, 32-octet vectors with
+   none of them in are skipped without stepping the automaton. */
+#define SCAN_THREADS   16
+#define SCAN_MAXHITS   (1 << 24)
+
+typedef struct {
+	SCAN *sc;
+	size_t from, to;     /* keep the hits starting in [from, to) */
+	size_t n, cap;
+	uint64_t *hits;      /* offset, signature pairs */
+	pthread_t tid;
+} SCANSLICE;
+
+static int sig_pattern(const char *s, uint8_t *pat, size_t max)
+{
+	size_t n;
+	int hi, v;
+
+	for (n = 0, hi = -1; *s; s++) {
+		if (isspace((unsigned char)*s)) {
+			if (hi >= 0) return -1; /* half an octet */
+			continue;
+		}
+		if (*s == '"') {
+			for (s++; *s && *s != '"'; s++) {
+				if (n == max) return -1;
+				pat[n++] = *s;
+			}
+			if (!*s) return -1;
+			continue;
+		}
+		if (!isxdigit((unsigned char)*s)) return -1;
+
+		v = isdigit((unsigned char)*s) ? *s - '0' : tolower((unsigned char)*s) - 'a' + 10;
+		if (hi < 0) {
+			hi = v;
+		} else {
+			if (n == max) return -1;
+			pat[n++] = hi << 4 | v;
+			hi = -1;
+		}
+	}
+	return hi >= 0 ? -1 : n;
+}
+
+void scan_free(SCAN *sc)
+{
+	if (!sc) return;
+	if (sc->win) delwin(sc->win);
+	free(sc->names);
+	free(sc->name);
+	free(sc->next);
+	free(sc->delta);
+	free(sc->fail);
+	free(sc->out);
+	free(sc->emit);
+	free(sc->depth);
+	free(sc->hits);
+	free(sc);
+}
+
+/* reads the signatures in `path`, and builds their automaton */
+SCAN* scan_compile(LAYOUT *l, const char *path)
+{
+	SCAN *sc;
+	FILE *io;
+	char line[1024], *name, *p;
+	void *np;
+	uint8_t pat[SCAN_PATLEN], *pats;
+	size_t *plen, npats, cap, total, i, j, s, t, head, tail, *queue;
+	int lineno, n, nfirst;
+	uint8_t seen[256];
+
+	io = fopen(path, "r");
+	if (!io) {
+		errorf(l, "%s: %s", path, strerror(errno));
+		return NULL;
+	}
+
+	sc = calloc(1, sizeof(SCAN));
+	pats = NULL;
+	plen = NULL;
+	queue = NULL;
+	npats = cap = total = 0;
+	if (!sc) goto fail;
+	snprintf(sc->path, sizeof(sc->path), "%s", path);
+
+	for (lineno = 1; fgets(line, sizeof(line), io); lineno++) {
+		for (name = line; isspace((unsigned char)*name); name++);
+		if (!*name || *name == '#') continue;
+		for (p = name; *p && !isspace((unsigned char)*p); p++);
+		if (*p) *p++ = '\0';
+
+		n = sig_pattern(p, pat, sizeof(pat));
+		if (n <= 0) {
+			errorf(l, "%s:%d: bad signature for %s", path, lineno, name);
+			goto fail;
+		}
+		if (total + n >= SCAN_STATES) {
+			errorf(l, "%s:%d: too many signatures", path, lineno);
+			goto fail;
+		}
+
+		if (npats == cap) {
+			cap = cap ? cap * 2 : 64;
+			if (!(np = realloc(sc->name, cap * sizeof(size_t)))) goto fail;
+			sc->name = np;
+			if (!(np = realloc(plen, cap * sizeof(size_t)))) goto fail;
+			plen = np;
+		}
+		if (!(np = realloc(pats, total + n))) goto fail;
+		pats = np;
+		if (!(np = realloc(sc->names, sc->nameslen + strlen(name) + 1))) goto fail;
+		sc->names = np;
+
+		memcpy(pats + total, pat, n);
+		total += n;
+		plen[npats] = n;
+		sc->name[npats] = sc->nameslen;
+		strcpy(sc->names + sc->nameslen, name);
+		sc->nameslen += strlen(name) + 1;
+		sc->maxlen = max(sc->maxlen, (size_t)n);
+		npats++;
+	}
+	fclose(io);
+	io = NULL;
+	if (npats == 0) {
+		errorf(l, "%s: no signatures", path);
+		goto fail;
+	}
+
+	/* the trie; state 0 is the root, and (so far) 0 means "no edge" */
+	sc->nsigs = npats;
+	sc->delta = calloc(total + 1, sizeof(*sc->delta));
+	sc->fail  = calloc(total + 1, sizeof(uint32_t));
+	sc->emit  = calloc(total + 1, sizeof(uint32_t));
+	sc->depth = calloc(total + 1, sizeof(uint32_t));
+	sc->out   = malloc((total + 1) * sizeof(int));
+	sc->next  = malloc(npats * sizeof(int));
+	queue     = malloc((total + 1) * sizeof(size_t));
+	if (!sc->delta || !sc->fail || !sc->emit || !sc->depth || !sc->out || !sc->next || !queue) goto fail;
+
+	memset(seen, 0, sizeof(seen));
+	nfirst = 0;
+	sc->nstates = 1;
+	sc->out[0] = -1;
+	for (i = 0, p = (char *)pats; i < npats; p += plen[i++]) {
+		for (s = 0, j = 0; j < plen[i]; j++) {
+			t = sc->delta[s][(uint8_t)p[j]];
+			if (!t) {
+				t = sc->nstates++;
+				sc->delta[s][(uint8_t)p[j]] = t;
+				sc->depth[t] = j + 1;
+				sc->out[t] = -1;
+			}
+			s = t;
+		}
+		sc->next[i] = sc->out[s]; /* identical patterns share a state */
+		sc->out[s] = i;
+
+		if (!seen[(uint8_t)p[0]]++ && nfirst++ < SCAN_PREFILTER) sc->first[nfirst - 1] = p[0];
+	}
+	sc->nfirst = nfirst <= SCAN_PREFILTER ? nfirst : 0;
+
+	/* failure links, breadth first, completing the DFA as we go */
+	head = tail = 0;
+	for (i = 0; i < 256; i++) {
+		if (sc->delta[0][i]) queue[tail++] = sc->delta[0][i];
+	}
+	while (head < tail) {
+		s = queue[head++];
+		sc->emit[s] = sc->out[s] >= 0 ? s : sc->emit[sc->fail[s]];
+		for (i = 0; i < 256; i++) {
+			t = sc->delta[s][i];
+			if (t) {
+				sc->fail[t] = sc->delta[sc->fail[s]][i];
+				queue[tail++] = t;
+			} else {
+				sc->delta[s][i] = sc->delta[sc->fail[s]][i];
+			}
+		}
+	}
+
+	free(queue);
+	free(pats);
+	free(plen);
+	return sc;
+
+fail:
+	if (io) fclose(io);
+	free(queue);
+	free(pats);
+	free(plen);
+	scan_free(sc);
+	return NULL;
+}
+
+static void scan_hit(SCANSLICE *w, size_t end, uint32_t state)
+{
+	SCAN *sc;
+	uint64_t *p, at;
+	uint32_t t;
+	int k;
+
+	sc = w->sc;
+	for (t = sc->emit[state]; t; t = sc->emit[sc->fail[t]]) {
+		at = end + 1 - sc->depth[t];
+		if (at < w->from || at >= w->to) continue;
+
+		for (k = sc->out[t]; k >= 0; k = sc->next[k]) {
+			if (w->n == w->cap) {
+				if (w->cap * 2 > SCAN_MAXHITS) {
+					sc->truncated = 1;
+					return;
+				}
+				p = realloc(w->hits, (w->cap ? w->cap * 2 : 1024) * 2 * sizeof(uint64_t));
+				if (!p) return;
+				w->hits = p;
+				w->cap = w->cap ? w->cap * 2 : 1024;
+			}
+			w->hits[2 * w->n]     = at;
+			w->hits[2 * w->n + 1] = k;
+			w->n++;
+		}
+	}
+}
+
+static void *scan_slice(void *_)
+{
+	SCANSLICE *w;
+	SCAN *sc;
+	PINWIN pw;
+	const uint8_t *p;
+	size_t i, i0, end, stop, hole;
+	uint32_t state;
+	uint64_t q[4];
+	vu8 v, m;
+	int k;
+
+	w  = (SCANSLICE *)_;
+	sc = w->sc;
+	p  = sc->data;
+	memset(&pw, 0, sizeof(pw));
+	pw.src = sc->src;
+
+	i     = w->from > sc->maxlen - 1 ? w->from - (sc->maxlen - 1) : 0;
+	stop  = min(w->to + sc->maxlen - 1, sc->size);
+	state = 0;
+	while (i < stop && !sc->job.cancel && !sc->truncated) {
+		i0  = i;
+		/* the automaton settles after maxlen zeros, so it can skip
+		   the rest of a hole (but hits inside holes are lost) */
+		i   = min(ext_next(sc->ext, sc->nextents, i, sc->maxlen, &hole), stop);
+		end = min(min((i / SRC_CHUNK + 1) * SRC_CHUNK, stop), hole);
+		pw_need(&pw, i, end - i);
+
+		while (i < end) {
+			if (state == 0 && sc->nfirst && i + 32 <= end) {
+				memcpy(&v, p + i, sizeof(v));
+				m = (vu8)(v == sc->first[0]);
+				for (k = 1; k < sc->nfirst; k++) {
+					m |= (vu8)(v == sc->first[k]);
+				}
+				memcpy(q, &m, sizeof(q));
+				if ((q[0] | q[1] | q[2] | q[3]) == 0) {
+					i += 32;
+					continue;
+				}
+			}
+			state = sc->delta[state][p[i]];
+			if (sc->emit[state]) scan_hit(w, i, state);
+			i++;
+		}
+		__atomic_fetch_add(&sc->job.progress, min(i, w->to) - min(i0, w->to), __ATOMIC_RELAXED);
+	}
+	pw_done(&pw);
+
+	qsort(w->hits, w->n, 2 * sizeof(uint64_t), offcmp);
+	return NULL;
+}
+
+static void *scan_run(void *_)
+{
+	SCAN *sc;
+	SCANSLICE w[SCAN_THREADS];
+	size_t slice, total;
+	int i, nw;
+
+	sc = (SCAN *)_;
+	sc->job.total = sc->size;
+
+	nw = nworkers(SCAN_THREADS);
+	slice = (sc->size / nw + SRC_CHUNK) / SRC_CHUNK * SRC_CHUNK;
+	memset(w, 0, sizeof(w));
+	for (i = 0; i < nw; i++) {
+		w[i].sc   = sc;
+		w[i].from = min(i * slice, sc->size);
+		w[i].to   = min((i + 1) * slice, sc->size);
+		if (w[i].from == w[i].to || pthread_create(&w[i].tid, NULL, scan_slice, &w[i]) != 0) {
+			w[i].to = w[i].from;
+		}
+	}
+	for (total = 0, i = 0; i < nw; i++) {
+		if (w[i].to > w[i].from) pthread_join(w[i].tid, NULL);
+		total += w[i].n;
+	}
+
+	sc->hits = malloc(total * 2 * sizeof(uint64_t) + 1);
+	for (i = 0; i < nw; i++) {
+		if (sc->hits) memcpy(sc->hits + 2 * sc->n, w[i].hits, w[i].n * 2 * sizeof(uint64_t));
+		if (sc->hits) sc->n += w[i].n;
+		free(w[i].hits);
+	}
+
+	sc->job.done = 1;
+	return NULL;
+}
+
+void lscan_close(LAYOUT *l)
+{
+	if (!l->scan || l->pane != P_HITS) return;
+
+	werase(l->scan->win);
+	wnoutrefresh(l->scan->win);
+	l->pane = P_NONE;
+}
+
+/* scans for the signatures in `path`; a NULL path shows the last hits */
+int lscan(LAYOUT *l, const char *path)
+{
+	SCAN *sc;
+
+	if (l->table) ltable_close(l);
+	if (l->pane == P_STRINGS) lstrings_close(l);
+
+	if (path) {
+		sc = scan_compile(l, path);
+		if (!sc) return -1;
+
+		if (l->scan) {
+			job_stop(&l->scan->job);
+			scan_free(l->scan);
+		}
+		sc->data = l->data;
+		sc->src  = l->src;
+		sc->ext  = l->extents;
+		sc->nextents = l->nextents;
+		sc->size = l->src ? l->src->len : l->len;
+		sc->win  = newwin(l->main_height - 1, COLS, 0, 0);
+		l->scan  = sc;
+		if (job_start(&sc->job, scan_run, sc) != 0) sc->job.done = 1;
+	}
+	if (!l->scan) {
+		errorf(l, "usage: :scan SIGNATURES-FILE");
+		return -1;
+	}
+	l->scan->home = l->offset + l->pos;
+	l->pane = P_HITS;
+	return 0;
+}
+
+void hdraw(LAYOUT *l)
+{
+	SCAN *sc;
+	size_t h, at, k;
+	int y, rows, w, x;
+
+	sc = l->scan;
+	rows = max(l->main_height - 2, 1);
+	if (sc->job.done) {
+		if (sc->sel >= sc->n) sc->sel = sc->n ? sc->n - 1 : 0;
+		if (sc->sel < sc->top)         sc->top = sc->sel;
+		if (sc->sel >= sc->top + rows) sc->top = sc->sel - rows + 1;
+		if (sc->n) lgoto(l, sc->hits[2 * sc->sel]);
+	}
+
+	werase(sc->win);
+	wattron(sc->win, A_BOLD);
+	if (!sc->job.done) {
+		mvwprintw(sc->win, 0, 0, "scanning for %d signatures from %s [%zu%%]", sc->nsigs, sc->path,
+			sc->job.total ? sc->job.progress * 100 / sc->job.total : 0);
+	} else {
+		mvwprintw(sc->win, 0, 0, "%zu hits for %d signatures from %s%s", sc->n, sc->nsigs, sc->path,
+			sc->truncated ? " (too many; stopped early)" : "");
+	}
+	wattroff(sc->win, A_BOLD);
+
+	for (w = 0, k = 0; k < sc->nsigs; k++) {
+		w = max(w, strlen(sc->names + sc->name[k]));
+	}
+	for (y = 0; sc->job.done && y < rows && sc->top + y < sc->n; y++) {
+		h  = sc->top + y;
+		at = sc->hits[2 * h];
+
+		if (h == sc->sel) wattron(sc->win, C_CURSOR);
+		mvwprintw(sc->win, y + 1, 0, "%10lx  %-*s ", at, w, sc->names + sc->name[sc->hits[2 * h + 1]]);
+		lpin(l, at, 16);
+		for (k = 0; k < 16 && at + k < l->len; k++) {
+			x = getcurx(sc->win);
+			if (x + 3 > COLS) break;
+			wprintw(sc->win, " %02x", l->data[at + k]);
+		}
+		lunpin(l, at, 16);
+		if (h == sc->sel) wattroff(sc->win, C_CURSOR);
+	}
+	wnoutrefresh(sc->win);
+}
+/* }}} */
+/* stride detection {{{ */
+/* Fixed-size records make the data repeat itself every `size` octets,
+   so the autocorrelation of a sample around the cursor peaks at the
+   record size (and its multiples).  The autocorrelation comes from an
+   FFT (Wiener-Khinchin: the inverse transform of the power spectrum),
+   which makes trying every lag up to STRIDE_MAX cheap. */
+
+/* in-place radix-2 FFT of re/im[0 .. n), n a power of two */
+static void fft(double *re, double *im, size_t n, int inverse)
+{
+	size_t i, j, k, len;
+	double a, wr, wi, cr, ci, t, ur, ui, vr, vi;
+
+	for (i = 1, j = 0; i < n; i++) { /* bit-reversal permutation */
+		for (k = n >> 1; j & k; k >>= 1) j ^= k;
+		j ^= k;
+		if (i < j) {
+			t = re[i]; re[i] = re[j]; re[j] = t;
+			t = im[i]; im[i] = im[j]; im[j] = t;
+		}
+	}
+
+	for (len = 2; len <= n; len <<= 1) {
+		a  = (inverse ? 2 : -2) * M_PI / len;
+		wr = cos(a);
+		wi = sin(a);
+		for (i = 0; i < n; i += len) {
+			cr = 1; ci = 0;
+			for (j = 0; j < len / 2; j++) {
+				ur = re[i + j];
+				ui = im[i + j];
+				vr = re[i + j + len / 2] * cr - im[i + j + len / 2] * ci;
+				vi = re[i + j + len / 2] * ci + im[i + j + len / 2] * cr;
+				re[i + j] = ur + vr;           im[i + j] = ui + vi;
+				re[i + j + len / 2] = ur - vr; im[i + j + len / 2] = ui - vi;
+				t  = cr * wr - ci * wi;
+				ci = cr * wi + ci * wr;
+				cr = t;
+			}
+		}
+	}
+}
+
+static void *stride_run(void *_)
+{
+	STRIDE *st;
+	double *re, *im, mean, *r;
+	size_t i, n, m, lag, best, most;
+
+	st = (STRIDE *)_;
+	n  = st->n;
+	for (m = 1; m < 2 * n; m <<= 1); /* room to keep the correlation linear */
+
+	re = calloc(m, sizeof(double));
+	im = calloc(m, sizeof(double));
+	if (!re || !im || n < 8) goto done;
+
+	for (mean = 0, i = 0; i < n; i++) mean += st->sample[i];
+	mean /= n;
+	for (i = 0; i < n; i++) re[i] = st->sample[i] - mean;
+
+	fft(re, im, m, 0);
+	if (st->job.cancel) goto done;
+	for (i = 0; i < m; i++) {
+		re[i] = re[i] * re[i] + im[i] * im[i];
+		im[i] = 0;
+	}
+	fft(re, im, m, 1);
+	if (st->job.cancel || re[0] <= 0) goto done;
+
+	/* normalize each lag by how many products went into it, and by
+	   the variance, so that scores from different lags compare */
+	r = re;
+	most = min(STRIDE_MAX, n / 4);
+	for (lag = 1; lag <= most + 1; lag++) {
+		r[lag] = (r[lag] / (n - lag)) / (r[0] / n);
+	}
+
+	/* multiples of the stride score as well as the stride itself;
+	   the first peak that comes close to the best one is the stride */
+	for (best = 0, lag = 2; lag <= most; lag++) {
+		if (!best || r[lag] > r[best]) best = lag;
+	}
+	if (best && r[best] >= STRIDE_MIN_SCORE) {
+		for (lag = 2; lag < best; lag++) {
+			if (r[lag] >= 0.9 * r[best] && r[lag] >= r[lag - 1] && r[lag] >= r[lag + 1]) break;
+		}
+		st->period = lag;
+		st->score  = r[lag];
+	}
+
+done:
+	free(re);
+	free(im);
+	st->job.done = 1;
+	return NULL;
+}
+
+void lstride_free(LAYOUT *l)
+{
+	if (!l->stride) return;
+	job_stop(&l->stride->job);
+	free(l->stride->sample);
+	free(l->stride);
+	l->stride = NULL;
+}
+
+/* starts looking for the record size around the cursor */
+int lstride(LAYOUT *l)
+{
+	STRIDE *st;
+	size_t at;
+
+	lstride_free(l);
+	st = calloc(1, sizeof(STRIDE));
+	if (!st) return -1;
+
+	st->n  = min(l->len, STRIDE_SAMPLE);
+	at     = l->offset + l->pos;
+	st->at = at > st->n / 2 ? min(at - st->n / 2, l->len - st->n) : 0;
+	st->sample = malloc(st->n);
+	if (!st->sample) {
+		free(st);
+		return -1;
+	}
+	lpin(l, st->at, st->n);
+	memcpy(st->sample, l->data + st->at, st->n);
+	lunpin(l, st->at, st->n);
+
+	l->stride = st;
+	if (job_start(&st->job, stride_run, st) != 0) st->job.done = 1;
+	return 0;
+}
+
+/* reports a finished stride search, once */
+void lstride_note(LAYOUT *l)
+{
+	STRIDE *st;
+
+	st = l->stride;
+	if (!st || !st->job.done || st->noted) return;
+	st->noted = 1;
+
+	if (!st->period) {
+		notef(l, "No stride stands out around offset %zu", st->at + st->n / 2);
+		return;
+	}
+	notef(l, "Stride looks like %d octets (%.0f%% correlated); :width to use it",
+		st->period, st->score * 100);
+}
+/* }}} */
+/* carving {{{ */
+/* :write copies the selection out to a file, in the background.  For
+   plain files the kernel does the copying (copy_file_range, which can
+   share the blocks on filesystems that do reflinks, or else sendfile),
+   so nothing passes through our memory; decoded images, and kernels
+   or filesystems that won't, get plain write()s from the data. */
+static void *carve_run(void *_)
+{
+	CARVE *cv;
+	PINWIN pw;
+	static const char *HOW[] = { "copy_file_range", "sendfile", "write" };
+	loff_t in;
+	ssize_t n;
+	size_t at, step, i, a, b;
+	int how;
+
+	cv = (CARVE *)_;
+	cv->job.total = cv->len;
+	memset(&pw, 0, sizeof(pw));
+	pw.src = cv->src;
+
+	/* copy_file_range, then sendfile, then write: each falls back to
+	   the next for good, if the kernel or filesystem won't do it */
+	how = cv->in >= 0 ? 0 : 2;
+	at  = 0;
+	if (how == 0 && cv->whole && ioctl(cv->out, FICLONE, cv->in) == 0) {
+		at = cv->len; /* the whole file, sharing all its blocks */
+		cv->job.progress = cv->len;
+		cv->how = "reflink";
+	}
+	for (; at < cv->len && !cv->job.cancel; at += n) {
+		step = min(cv->len - at, CARVE_STEP);
+		in   = cv->off + at;
+		switch (how) {
+		case 0: n = copy_file_range(cv->in, &in, cv->out, NULL, step, 0); break;
+		case 1: n = sendfile(cv->out, cv->in, &in, step);                 break;
+		default:
+			pw_need(&pw, cv->off + at, step);
+			n = write(cv->out, cv->data + cv->off + at, step);
+			break;
+		}
+		if (n < 0 && how < 2 && (errno == EXDEV || errno == EINVAL || errno == ENOSYS
+		                      || errno == EOPNOTSUPP || errno == EBADF)) {
+			how++;
+			n = 0;
+			continue;
+		}
+		cv->how = HOW[how];
+		if (n <= 0) {
+			if (n < 0 && errno == EINTR) {
+				n = 0;
+				continue;
+			}
+			cv->err = n < 0 ? errno : EIO;
+			break;
+		}
+		cv->job.progress = at + n;
+	}
+	pw_done(&pw);
+	/* the copy came from the file, as it is on disk */
+	for (i = 0; i < cv->npatch && !cv->err && !cv->job.cancel; i++) {
+		a = max(cv->patch[i].start, cv->off);
+		b = min(cv->patch[i].end, cv->off + cv->len);
+		if (a < b && pwrite(cv->out, cv->data + a, b - a, a - cv->off) != b - a) {
+			cv->err = errno ? errno : EIO;
+		}
+	}
+	if (close(cv->out) != 0 && !cv->err) cv->err = errno;
+	if (cv->job.cancel && !cv->err) cv->err = ECANCELED;
+	if (!cv->err && rename(cv->tmp, cv->path) != 0) cv->err = errno;
+	if (cv->err) unlink(cv->tmp); /* and whatever was at path is still there */
+	cv->job.done = 1;
+	return NULL;
+}
+
+void lcarve_free(LAYOUT *l)
+{
+	if (!l->carve) return;
+	job_stop(&l->carve->job);
+	free(l->carve->patch);
+	free(l->carve);
+	l->carve = NULL;
+}
+
+/* starts writing [off, off + len) out to `path` */
+int lcarve(LAYOUT *l, const char *path, size_t off, size_t len)
+{
+	CARVE *cv;
+	struct stat st, self;
+	mode_t mode;
+
+	if (l->carve && !l->carve->job.done) {
+		errno = EBUSY;
+		return -1;
+	}
+	mode = umask(0);
+	umask(mode);
+	mode = 0666 & ~mode;
+	if (stat(path, &st) == 0) {
+		/* the view is a MAP_PRIVATE of that very file */
+		if (l->fd >= 0 && fstat(l->fd, &self) == 0
+		 && st.st_dev == self.st_dev && st.st_ino == self.st_ino) {
+			errno = EEXIST;
+			return -1;
+		}
+		mode = st.st_mode & 07777;
+	}
+	if (strlen(path) >= sizeof(cv->path)) {
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+	lcarve_free(l);
+	cv = calloc(1, sizeof(CARVE));
+	if (!cv) return -1;
+	if (l->ndirty) {
+		cv->patch = malloc(l->ndirty * sizeof(EXTENT));
+		if (!cv->patch) {
+			free(cv);
+			return -1;
+		}
+		memcpy(cv->patch, l->dirty, l->ndirty * sizeof(EXTENT));
+		cv->npatch = l->ndirty;
+	}
+
+	snprintf(cv->path, sizeof(cv->path), "%s", path);
+	snprintf(cv->tmp, sizeof(cv->tmp), "%s.XXXXXX", path);
+	cv->out = mkstemp(cv->tmp);
+	if (cv->out < 0) {
+		free(cv->patch);
+		free(cv);
+		return -1;
+	}
+	fchmod(cv->out, mode);
+	/* decoded images have no file to copy from */
+	cv->in   = !l->src || l->src->fill == file_fill ? l->fd : -1;
+	cv->data = l->data;
+	cv->src  = l->src;
+	cv->off  = off;
+	cv->len  = len;
+	cv->whole = cv->in >= 0 && off == 0 && len == l->len;
+
+	l->carve = cv;
+	if (job_start(&cv->job, carve_run, cv) != 0) {
+		cv->err = errno;
+		close(cv->out);
+		unlink(cv->tmp);
+		cv->job.done = 1;
+	}
+	return 0;
+}
+
+/* shows how far along a :write is, and how it went, once */
+void lcarve_note(LAYOUT *l)
+{
+	CARVE *cv;
+	char a[16], b[16];
+
+	cv = l->carve;
+	if (!cv || cv->noted) return;
+	if (!cv->job.done) {
+		hsize(a, sizeof(a), cv->job.progress);
+		hsize(b, sizeof(b), cv->len);
+		notef(l, "Writing %s... %s of %s", cv->path, a, b);
+		return;
+	}
+	cv->noted = 1;
+
+	if (cv->err) {
+		errorf(l, "Writing %s failed after %zu octets: %s", cv->path, cv->job.progress, strerror(cv->err));
+		return;
+	}
+	notef(l, "Wrote %zu octets to %s (%s)", cv->len, cv->path, cv->how ? cv->how : "nothing to copy");
+}
+/* }}} */
+/* patching {{{ */
+/* The file is mapped MAP_PRIVATE, so once :patch makes the mapping
+   writable, a patch is just a store: the kernel copies the page, and
+   every reader (drawing, the status bar, searches, background passes)
+   sees the new octets for free.  All that's left to remember is which
+   ranges changed, so that saving writes back only those. */
+
+/* is `at` patched (and not yet saved in place)? */
+int ldirty(LAYOUT *l, size_t at)
+{
+	size_t lo, hi, mid;
+
+	lo = 0; hi = l->ndirty;
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (l->dirty[mid].end <= at) lo = mid + 1;
+		else hi = mid;
+	}
+	return lo < l->ndirty && l->dirty[lo].start <= at;
+}
+
+/* notes [a, b) as patched, merging it with any ranges it touches */
+static int ldirty_add(LAYOUT *l, size_t a, size_t b)
+{
+	EXTENT *e;
+	size_t i, j, lo, hi, mid;
+
+	lo = 0; hi = l->ndirty;
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (l->dirty[mid].end < a) lo = mid + 1;
+		else hi = mid;
+	}
+	for (i = j = lo; j < l->ndirty && l->dirty[j].start <= b; j++) {
+		a = min(a, l->dirty[j].start);
+		b = max(b, l->dirty[j].end);
+	}
+	if (i == j) { /* nothing to merge with; make room */
+		e = realloc(l->dirty, (l->ndirty + 1) * sizeof(EXTENT));
+		if (!e) return -1;
+		l->dirty = e;
+		memmove(e + i + 1, e + i, (l->ndirty - i) * sizeof(EXTENT));
+		l->ndirty++;
+		j++;
+	}
+	l->dirty[i].start = a;
+	l->dirty[i].end   = b;
+	memmove(l->dirty + i + 1, l->dirty + j, (l->ndirty - j) * sizeof(EXTENT));
+	l->ndirty -= j - i - 1;
+	return 0;
+}
+
+int lpatch(LAYOUT *l)
+{
+	if (l->patching) return 0;
+	if (l->src) { /* decoded chunks get evicted, patches and all */
+		errno = ENOTSUP;
+		return -1;
+	}
+	if (mprotect(l->data, l->len, PROT_READ | PROT_WRITE) != 0) return -1;
+	l->patching = 1;
+	return 0;
+}
+
+/* overwrites the octets at `at` with `n` new ones */
+int lpoke(LAYOUT *l, size_t at, const uint8_t *v, size_t n)
+{
+	if (!l->patching) {
+		errno = EPERM;
+		return -1;
+	}
+	if (at >= l->len || n > l->len - at) {
+		errno = ERANGE;
+		return -1;
+	}
+	if (ldirty_add(l, at, at + n) != 0) return -1;
+	memcpy(l->data + at, v, n);
+	l->quitting = 0;
+	return 0;
+}
+
+/* writes the patched ranges back to the file itself */
+int lsave(LAYOUT *l, size_t *saved)
+{
+	size_t i, n;
+	int fd;
+
+	fd = open(l->path, O_WRONLY);
+	if (fd < 0) return -1;
+	for (*saved = i = 0; i < l->ndirty; i++) {
+		n = l->dirty[i].end - l->dirty[i].start;
+		if (pwrite(fd, l->data + l->dirty[i].start, n, l->dirty[i].start) != n) {
+			if (!errno) errno = EIO;
+			close(fd);
+			return -1;
+		}
+		*saved += n;
+	}
+	if (fsync(fd) != 0 || close(fd) != 0) return -1;
+
+	free(l->dirty);
+	l->dirty  = NULL;
+	l->ndirty = 0;
+	return 0;
+}
+/* }}} */
+/* plots {{{ */
+/* `:plot TYPE` reads the selection (or everything from the cursor on)
+   as a series of samples -- 16sd, 32f and so on, as in the status bar
+   -- and draws it in braille, two columns of dots across and four
+   rows down per cell.  Each column of dots spans the smallest and
+   largest of the samples it covers, so a spike stays visible however
+   far out the plot is zoomed.
+
+   Those extremes come from a pyramid, built in the background: level
+   0 holds them for every PLOT_LEAF samples (found eight lanes at a
+   time), and each level above halves the one below.  At 2^z samples
+   per column, each column is one entry of level z - PLOT_LEAF_LOG, so
+   drawing costs the same at any zoom, anywhere in the series.  Zoomed
+   in closer than a leaf, the samples are read directly. */
+#define PLOT_LEAF_LOG 8
+#define PLOT_LEAF     (1 << PLOT_LEAF_LOG)
+#define PLOT_MAX      ((size_t)1 << 28) /* most samples in a plot */
+#define PLOT_DEFAULT  ((size_t)1 << 24) /* ... unless asked for more */
+#define PLOT_COLS     1024              /* widest plot, in cells */
+
+typedef float   vf32 __attribute__((vector_size(32)));
+typedef int32_t vi32 __attribute__((vector_size(32)));
+
+/* reads samples [i, i + n) into lo and hi, as floats; a NaN reads as
+   +inf in lo and -inf in hi, so it never counts as an extreme */
+static void plot_load(PLOT *p, size_t i, size_t n, float *lo, float *hi)
+{
+	const uint8_t *d;
+	size_t k;
+
+	d = p->data + p->at + i * (p->bits / 8);
+#define LOAD(get, size) for (k = 0; k < n; k++) lo[k] = get(d + (size) * k)
+	switch (p->kind << 8 | p->bits) {
+	case PLOT_U << 8 |  8: LOAD(as_u8,  1); break;
+	case PLOT_U << 8 | 16: LOAD(as_u16, 2); break;
+	case PLOT_U << 8 | 32: LOAD(as_u32, 4); break;
+	case PLOT_U << 8 | 64: LOAD(as_u64, 8); break;
+	case PLOT_S << 8 |  8: LOAD(as_i8,  1); break;
+	case PLOT_S << 8 | 16: LOAD(as_i16, 2); break;
+	case PLOT_S << 8 | 32: LOAD(as_i32, 4); break;
+	case PLOT_S << 8 | 64: LOAD(as_i64, 8); break;
+	case PLOT_F << 8 | 32: LOAD(as_f32, 4); break;
+	case PLOT_F << 8 | 64: LOAD(as_f64, 8); break;
+	}
+#undef LOAD
+	memcpy(hi, lo, n * sizeof(float));
+	if (p->kind != PLOT_F) return;
+	for (k = 0; k < n; k++) {
+		if (isnan(lo[k])) {
+			lo[k] =  INFINITY;
+			hi[k] = -INFINITY;
+		}
+	}
+}
+
+/* the extremes of samples [i, i + n), for n up to PLOT_LEAF */
+static void plot_leaf(PLOT *p, size_t i, size_t n, float *lo, float *hi)
+{
+	float a[PLOT_LEAF], b[PLOT_LEAF];
+	vf32 va, vb, t;
+	vi32 m;
+	int k;
+
+	plot_load(p, i, n, a, b);
+	for (k = n; k < PLOT_LEAF; k++) {
+		a[k] =  INFINITY;
+		b[k] = -INFINITY;
+	}
+	memcpy(&va, a, sizeof(va));
+	memcpy(&vb, b, sizeof(vb));
+	for (k = 8; k < PLOT_LEAF; k += 8) {
+		memcpy(&t, a + k, sizeof(t));
+		m  = va < t;
+		va = (vf32)(((vi32)va & m) | ((vi32)t & ~m));
+
+		memcpy(&t, b + k, sizeof(t));
+		m  = vb > t;
+		vb = (vf32)(((vi32)vb & m) | ((vi32)t & ~m));
+	}
+	*lo = va[0];
+	*hi = vb[0];
+	for (k = 1; k < 8; k++) {
+		*lo = min(*lo, va[k]);
+		*hi = max(*hi, vb[k]);
+	}
+}
+
+static void *plot_build(void *_)
+{
+	PLOT *p;
+	PINWIN pw;
+	size_t i, j, b, size;
+	int k;
+
+	p = (PLOT *)_;
+	memset(&pw, 0, sizeof(pw));
+	pw.src = p->src;
+
+	size = p->bits / 8;
+	for (i = 0; i < p->count[0] && !p->job.cancel; i++) {
+		pw_need(&pw, p->at + i * PLOT_LEAF * size, PLOT_LEAF * size);
+		plot_leaf(p, i * PLOT_LEAF, min(PLOT_LEAF, p->n - i * PLOT_LEAF), &p->lo[0][i], &p->hi[0][i]);
+		p->job.progress = i;
+	}
+	pw_done(&pw);
+
+	for (k = 1; k < p->levels && !p->job.cancel; k++) {
+		for (j = 0; j < p->count[k]; j++) {
+			b = min(2 * j + 1, p->count[k - 1] - 1);
+			p->lo[k][j] = min(p->lo[k - 1][2 * j], p->lo[k - 1][b]);
+			p->hi[k][j] = max(p->hi[k - 1][2 * j], p->hi[k - 1][b]);
+		}
+	}
+	p->job.done = 1;
+	return NULL;
+}
+
+static void plot_free(PLOT *p)
+{
+	int k;
+
+	for (k = 0; k < p->levels; k++) {
+		free(p->lo[k]);
+		free(p->hi[k]);
+	}
+	if (p->win) delwin(p->win);
+	free(p);
+}
+
+void lplot_free(LAYOUT *l)
+{
+	if (!l->plot) return;
+
+	job_stop(&l->plot->job);
+	plot_free(l->plot);
+	l->plot = NULL;
+	if (l->pane == P_PLOT) l->pane = P_NONE;
+}
+
+void lplot_close(LAYOUT *l)
+{
+	if (!l->plot || l->pane != P_PLOT) return;
+
+	werase(l->plot->win);
+	wnoutrefresh(l->plot->win);
+	l->pane = P_NONE;
+}
+
+/* how many columns of dots there are across the plot */
+static size_t plot_width(void)
+{
+	return (size_t)min(COLS, PLOT_COLS) * 2;
+}
+
+/* the closest zoom that still fits the whole series on screen */
+static int plot_fit(PLOT *p)
+{
+	int z;
+
+	for (z = 0; ((p->n - 1) >> z) >= plot_width(); z++)
+		;
+	return z;
+}
+
+/* zooms to 2^z samples per column, keeping the cursor where it is on screen */
+static void plot_zoom(PLOT *p, int z)
+{
+	size_t x;
+
+	z = max(min(z, plot_fit(p)), 0);
+	x = (p->cur - p->first) >> p->zoom;
+	p->first = p->cur - min(p->cur, x << z);
+	p->first &= ~(((size_t)1 << z) - 1);
+	p->zoom = z;
+}
+
+/* plots n samples of the given kind and width, starting at `at` */
+int lplot(LAYOUT *l, int kind, int bits, size_t at, size_t n)
+{
+	PLOT *p;
+	int k;
+
+	if (l->table) ltable_close(l);
+	if (l->pane == P_STRINGS) lstrings_close(l);
+	if (l->pane == P_HITS)    lscan_close(l);
+	lplot_free(l);
+
+	p = calloc(1, sizeof(PLOT));
+	if (!p) return -1;
+	p->kind = kind;
+	p->bits = bits;
+	p->at   = at;
+	p->n    = n;
+	p->data = l->data;
+	p->src  = l->src;
+
+	p->count[0] = (n + PLOT_LEAF - 1) / PLOT_LEAF;
+	for (k = 0; k == 0 || p->count[k - 1] > 1; k++) {
+		if (k) p->count[k] = (p->count[k - 1] + 1) / 2;
+		p->lo[k] = malloc(p->count[k] * sizeof(float));
+		p->hi[k] = malloc(p->count[k] * sizeof(float));
+		p->levels = k + 1;
+		if (!p->lo[k] || !p->hi[k]) {
+			plot_free(p);
+			return -1;
+		}
+	}
+
+	p->job.total = p->count[0];
+	if (job_start(&p->job, plot_build, p) != 0) {
+		plot_free(p);
+		return -1;
+	}
+	p->win  = newwin(l->main_height - 1, COLS, 0, 0);
+	p->zoom = plot_fit(p);
+	l->plot = p;
+	p->home = l->offset + l->pos;
+	l->pane = P_PLOT;
+	return 0;
+}
+
+/* the extremes of the samples under column x; 0 past the end */
+static int plot_column(LAYOUT *l, PLOT *p, size_t x, float *lo, float *hi)
+{
+	float a[PLOT_LEAF], b[PLOT_LEAF];
+	size_t i, n, k, size;
+
+	i = p->first + (x << p->zoom);
+	if (i >= p->n) return 0;
+	if (p->zoom >= PLOT_LEAF_LOG) {
+		k = p->zoom - PLOT_LEAF_LOG;
+		*lo = p->lo[k][i >> p->zoom];
+		*hi = p->hi[k][i >> p->zoom];
+		return 1;
+	}
+
+	size = p->bits / 8;
+	n = min((size_t)1 << p->zoom, p->n - i);
+	lpin(l, p->at + i * size, n * size);
+	plot_load(p, i, n, a, b);
+	lunpin(l, p->at + i * size, n * size);
+	*lo = a[0];
+	*hi = b[0];
+	for (k = 1; k < n; k++) {
+		*lo = min(*lo, a[k]);
+		*hi = max(*hi, b[k]);
+	}
+	return 1;
+}
+
+void pdraw(LAYOUT *l)
+{
+	PLOT *p;
+	float lo[PLOT_COLS * 2], hi[PLOT_COLS * 2], vmin, vmax, v, w;
+	int top[PLOT_COLS * 2], bot[PLOT_COLS * 2];
+	size_t x, width, size, cx;
+	uint8_t *dots;
+	wchar_t wc[2];
+	cchar_t cc;
+	int y, rows, braille, ok, prev;
+
+	p = l->plot;
+	rows  = max(l->main_height - 2, 1);
+	width = plot_width();
+	size  = p->bits / 8;
+	p->cur = min(p->cur, p->n - 1);
+	if (p->cur < p->first || p->cur - p->first >= width << p->zoom) {
+		p->first = p->cur - min(p->cur, (width / 2) << p->zoom);
+		p->first &= ~(((size_t)1 << p->zoom) - 1);
+	}
+	lgoto(l, p->at + p->cur * size);
+
+	werase(p->win);
+	wattron(p->win, A_BOLD);
+	ok = p->job.done || p->zoom < PLOT_LEAF_LOG;
+	if (!ok) {
+		mvwprintw(p->win, 0, 0, "plotting %zu samples from %lx [%zu%%]", p->n, p->at,
+			p->job.total ? p->job.progress * 100 / p->job.total : 0);
+		wattroff(p->win, A_BOLD);
+		wnoutrefresh(p->win);
+		return;
+	}
+
+	vmin = INFINITY;
+	vmax = -INFINITY;
+	for (x = 0; x < width; x++) {
+		if (!plot_column(l, p, x, &lo[x], &hi[x])) break;
+		if (isfinite(lo[x])) { vmin = min(vmin, lo[x]); vmax = max(vmax, lo[x]); }
+		if (isfinite(hi[x])) { vmin = min(vmin, hi[x]); vmax = max(vmax, hi[x]); }
+	}
+	width = x;
+	if (vmin > vmax) vmin = vmax = 0; /* nothing but NaNs and infinities */
+	if (vmin == vmax) { vmin -= 1; vmax += 1; }
+
+	mvwprintw(p->win, 0, 0, "%zu samples from %lx, %zu per dot, %g to %g; [%zu] = ",
+		p->n, p->at, (size_t)1 << p->zoom, vmin, vmax, p->cur);
+	lpin(l, p->at + p->cur * size, size);
+	plot_load(p, p->cur, 1, &v, &w);
+	lunpin(l, p->at + p->cur * size, size);
+	if (v > w) wprintw(p->win, "nan");
+	else       wprintw(p->win, "%g", v);
+	wattroff(p->win, A_BOLD);
+
+	/* each column of dots runs from its largest sample to its smallest,
+	   stretched to meet the column before, so the trace is unbroken */
+	for (x = 0; x < width; x++) {
+		if (lo[x] > hi[x]) { top[x] = bot[x] = -1; continue; }
+		top[x] = lrint((vmax - max(min(hi[x], vmax), vmin)) / (vmax - vmin) * (rows * 4 - 1));
+		bot[x] = lrint((vmax - max(min(lo[x], vmax), vmin)) / (vmax - vmin) * (rows * 4 - 1));
+	}
+	dots = calloc(rows, width / 2 + 1);
+	if (!dots) {
+		wnoutrefresh(p->win);
+		return;
+	}
+	for (x = 0; x < width; x++) {
+		if (top[x] < 0) continue;
+		prev = x > 0 && top[x - 1] >= 0;
+		for (y = min(top[x], prev ? bot[x - 1] : top[x]); y <= max(bot[x], prev ? top[x - 1] : bot[x]); y++) {
+			/* braille dots 1-3 and 7 are down the left, 4-6 and 8 the right */
+			dots[(y / 4) * (width / 2 + 1) + x / 2] |= y % 4 == 3 ? 0x40 << (x & 1)
+			                                                   : 1 << (y % 4 + 3 * (x & 1));
+		}
+	}
+
+	braille = wcwidth(0x2800) == 1;
+	cx = ((p->cur - p->first) >> p->zoom) / 2;
+	for (y = 0; y < rows; y++) {
+		wmove(p->win, y + 1, 0);
+		for (x = 0; x < (width + 1) / 2; x++) {
+			if (x == cx) wattron(p->win, C_CURSOR);
+			if (braille) {
+				wc[0] = 0x2800 | dots[y * (width / 2 + 1) + x];
+				wc[1] = 0;
+				setcchar(&cc, wc, 0, 0, NULL);
+				wadd_wch(p->win, &cc);
+			} else {
+				waddch(p->win, dots[y * (width / 2 + 1) + x] ? '#' : ' ');
+			}
+			if (x == cx) wattroff(p->win, C_CURSOR);
+		}
+	}
+	free(dots);
+	wnoutrefresh(p->win);
+}
+/* }}} */
+/* layout lifecycle {{{ */
+/* Everything that comes from the configuration (status bar fields,
+   columns, struct definitions) lives in the config's arena, and the
+   windows are cut to the size of the terminal.  Those are all that a
+   reload or a resize rebuilds; the data, and whatever has been found
+   out about it (index, strings, scans, ...), stays put. */
+static void lwindows_free(LAYOUT *l)
+{
+	int i;
+
+	for (i = 0; i < l->ncol; i++) {
+		if (l->columns[i].win) delwin(l->columns[i].win);
+		l->columns[i].win = NULL;
+	}
+	if (l->status)  delwin(l->status);
+	if (l->command) delwin(l->command);
+	l->status = l->command = NULL;
+}
+
+/* (re)builds the layout for `c`; for the config it already has, that
+   just means new windows, for the current terminal size */
+int lconfigure(LAYOUT *l, CONFIG *c)
+{
+	CONFIG *old;
+	size_t at;
+	int i, width, record;
+
+	old    = l->config;
+	record = l->record;
+	at     = l->offset + l->pos;
+	lrecord(l, -1);
+	if (old && old != c && l->table) ltable_close(l); /* its struct goes */
+	lwindows_free(l);
+
+	if (old != c) {
+		l->nfields = parse_status(c->arena, c->status, NULL);
+		if (l->nfields < 0) return -1;
+		l->fields = arena_alloc(c->arena, l->nfields * sizeof(FIELD));
+		if (!l->fields) return -1;
+		parse_status(c->arena, c->status, l->fields);
+
+		l->ncol = strlen(c->layout);
+		l->columns = arena_alloc(c->arena, l->ncol * sizeof(COLUMN));
+		if (!l->columns) return -1;
+		for (i = 0; i < l->ncol; i++) {
+			switch (c->layout[i]) {
+			case 'X': cfgcol(&l->columns[i], pr_hex_pretty, 3, 1); break;
+			case 'x': cfgcol(&l->columns[i], pr_hex,        3, 1); break;
+			case 'a': cfgcol(&l->columns[i], pr_ascii,      1, 0); break;
+			case 'k': cfgcol(&l->columns[i], pr_ascii,      1, 0);
+			          l->columns[i].keyed = 1;
+			          break;
+			case 'u': cfgcol(&l->columns[i], NULL,          1, 0);
+			          l->columns[i].text = TEXT_UTF8;
+			          break;
+			case 'w': cfgcol(&l->columns[i], NULL,          1, 0);
+			          l->columns[i].text = TEXT_UTF16LE;
+			          break;
+			case 'W': cfgcol(&l->columns[i], NULL,          1, 0);
+			          l->columns[i].text = TEXT_UTF16BE;
+			          break;
+			case 'O': cfgcol(&l->columns[i], pr_oct_pretty, 4, 1); break;
+			case 'o': cfgcol(&l->columns[i], pr_oct,        4, 1); break;
+			default:
+				printw("bad layout type '%c'\n", c->layout[i]);
+				anyexit(1);
+				break;
+			}
+		}
+
+		l->structs  = c->structs;
+		l->nstructs = c->nstructs;
+		l->pf.mode  = c->prefetch;
+		l->budget   = c->budget;
+		if (l->src && l->budget) l->src->budget = max(l->budget / SRC_CHUNK, 2);
+		if (record >= l->nstructs) record = -1;
+		width = c->width;
+	} else {
+		width = l->width; /* a resize keeps any :width */
+	}
+
+	l->st_height = 1;
+	for (i = 0; i < strlen(c->status); i++) {
+		if (c->status[i] == '\n') l->st_height++;
+	}
+	l->status = newwin(l->st_height, COLS, LINES - l->st_height - 1, 0);
+	wattron(l->status, C_STATUS);
+	wprintw(l->status, "%*s", COLS, "");
+	l->command = newwin(1, COLS, LINES - 1, 0);
+	l->main_height = max(LINES - l->st_height, 1);
+
+	/* a width that doesn't fit the terminal gets as much as does; a
+	   terminal too narrow for even one octet gets what fits of that */
+	if (lwidth(l, min(width, lmaxwidth(l))) != 0) lcolumns(l, 1);
+	if (l->table)   wresize(l->table->win,   max(l->main_height - 1, 1), COLS);
+	if (l->strings) wresize(l->strings->win, max(l->main_height - 1, 1), COLS);
+	if (l->scan)    wresize(l->scan->win,    max(l->main_height - 1, 1), COLS);
+	if (l->plot)    wresize(l->plot->win,    max(l->main_height - 1, 1), COLS);
+	if (record >= 0) lrecord(l, record);
+
+	if (l->len) { /* rows may be wider or narrower; keep the cursor on screen */
+		l->offset = l->extents ? lrow(l, l->offset) : l->offset - l->offset % l->width;
+		lgoto(l, at);
+	}
+	l->config = c;
+	if (old && old != c) arena_free(old->arena);
+
+	werase(stdscr); /* whatever was drawn for the old layout */
+	wnoutrefresh(stdscr);
+	return 0;
+}
+
+LAYOUT* layout(CONFIG *c)
+{
+	LAYOUT *l;
+
+	l = calloc(1, sizeof(LAYOUT));
+	if (!l) return NULL;
+
+	l->record     = -1;
+	l->decoded_at = (size_t)-1;
+	if (lconfigure(l, c) != 0) {
+		free(l);
+		return NULL;
+	}
+	return l;
+}
+/* }}} */
+/* text columns {{{ */
+/* Text columns decode a whole row at a time, so that a character
+   spanning several octets lands on the first of them: its glyph is
+   drawn in that octet's cell, and the cells for the rest of the
+   sequence are left blank (or covered by the right half of a wide
+   glyph -- which always takes at least two octets, in UTF-8 and
+   UTF-16 alike, so the grid never shifts).  Decoding reaches up to
+   TEXT_REACH octets past either end of the row, to finish a sequence
+   that crosses into the next row, or find the start of one that
+   crossed into this one.
+
+   Most text is ASCII, and so is most of what sits around it; rows
+   that are entirely ASCII (in UTF-16, entirely ASCII units) are
+   checked and widened 32 octets at a time. */
+#define TEXT_REACH 3
+
+#define GLYPH_CONT   0x80000000u /* continues a sequence that starts earlier */
+#define GLYPH_BAD    0x40000000u /* not a character; drawn as '.' */
+#define GLYPH(cp,n)  ((uint32_t)(cp) | (uint32_t)(n) << 24)
+#define GLYPH_CP(g)  ((g) & 0x1fffff)
+#define GLYPH_LEN(g) (((g) >> 24) & 7)
+
+/* the last row decoded, one glyph per octet */
+static COLUMN   *text_col;
+static size_t    text_row, text_n;
+static uint32_t *text_glyph;
+static size_t    text_cap;
+
+/* true if none of the n octets at p have a bit in `mask` set; the mask
+   repeats every two octets, so p must be aligned to a UTF-16 unit */
+static int text_clean(const uint8_t *p, size_t n, uint8_t even, uint8_t odd)
+{
+	vu8 v, m, acc;
+	size_t i;
+
+	for (i = 0; i < 32; i++) m[i] = i & 1 ? odd : even;
+	acc = m & 0;
+	for (i = 0; i + 32 <= n; i += 32) {
+		memcpy(&v, p + i, 32);
+		acc |= v & m;
+	}
+	for (; i < n; i++) {
+		if (p[i] & (i & 1 ? odd : even)) return 0;
+	}
+	for (i = 0; i < 32; i++) {
+		if (acc[i]) return 0;
+	}
+	return 1;
+}
+
+/* decodes the UTF-8 sequence at p (with n octets left), returning its
+   length, or 0 if it is malformed, overlong, or a surrogate */
+static int utf8_seq(const uint8_t *p, size_t n, uint32_t *cp)
+{
+	uint32_t c;
+	int len, i;
+
+	if (p[0] < 0x80) { *cp = p[0]; return 1; }
+	if      (p[0] < 0xc2) return 0;
+	else if (p[0] < 0xe0) { len = 2; c = p[0] & 0x1f; }
+	else if (p[0] < 0xf0) { len = 3; c = p[0] & 0x0f; }
+	else if (p[0] < 0xf5) { len = 4; c = p[0] & 0x07; }
+	else return 0;
+
+	if ((size_t)len > n) return 0;
+	for (i = 1; i < len; i++) {
+		if ((p[i] & 0xc0) != 0x80) return 0;
+		c = c << 6 | (p[i] & 0x3f);
+	}
+	if ((len == 3 && c < 0x800) || (len == 4 && (c < 0x10000 || c > 0x10ffff))
+	 || (c >= 0xd800 && c <= 0xdfff)) return 0;
+	*cp = c;
+	return len;
+}
+
+/* records a sequence of len octets at p (decoded as g) against the row */
+static void text_mark(size_t p, int len, uint32_t g)
+{
+	size_t q;
+
+	for (q = p; q < p + len; q++) {
+		if (q >= text_row && q < text_row + text_n) {
+			text_glyph[q - text_row] = q == p ? g : GLYPH_CONT;
+		}
+	}
+}
+
+static void text_utf8(const uint8_t *d, size_t lo, size_t hi)
+{
+	size_t p, i, end;
+	uint32_t cp;
+	int len, k;
+
+	end = text_row + text_n;
+	if (text_clean(d + lo, hi - lo, 0x80, 0x80)) {
+		for (i = 0; i < text_n; i++) {
+			text_glyph[i] = GLYPH(d[text_row + i], 1);
+		}
+		return;
+	}
+
+	/* lead octets are never continuations, so wherever decoding
+	   starts, it finds the same sequences the previous row did */
+	p = text_row;
+	for (k = 1; k <= TEXT_REACH && text_row >= lo + k; k++) {
+		if (utf8_seq(d + text_row - k, hi - (text_row - k), &cp) > k) {
+			p = text_row - k;
+			break;
+		}
+	}
+	while (p < end) {
+		len = utf8_seq(d + p, hi - p, &cp);
+		if (!len) {
+			text_mark(p++, 1, GLYPH_BAD | GLYPH(0, 1));
+			continue;
+		}
+		text_mark(p, len, GLYPH(cp, len));
+		p += len;
+	}
+}
+
+static void text_utf16(const uint8_t *d, size_t lo, size_t hi, int be)
+{
+	size_t p, i, end;
+	uint32_t u, v;
+
+#define UNIT(at) (be ? (uint32_t)d[at] << 8 | d[(at) + 1] \
+                     : (uint32_t)d[(at) + 1] << 8 | d[at])
+	/* units start at even offsets; one at an odd row start began in
+	   the row before */
+	p   = text_row & ~(size_t)1;
+	end = text_row + text_n;
+	if ((end & 1) == 0 || end < hi) {
+		i = end + (end & 1);
+		if (text_clean(d + p, i - p, be ? 0xff : 0x80, be ? 0x80 : 0xff)) {
+			for (; p < end; p += 2) {
+				text_mark(p, 2, GLYPH(d[p + be], 2));
+			}
+			return;
+		}
+	}
+
+	if (p >= lo + 2 && (UNIT(p) & 0xfc00) == 0xdc00
+	               && (UNIT(p - 2) & 0xfc00) == 0xd800) {
+		p -= 2; /* the low half of a pair */
+	}
+	while (p < end) {
+		if (p + 2 > hi) {
+			text_mark(p++, 1, GLYPH_BAD | GLYPH(0, 1));
+			continue;
+		}
+		u = UNIT(p);
+		if ((u & 0xfc00) == 0xd800 && p + 4 <= hi
+		 && ((v = UNIT(p + 2)) & 0xfc00) == 0xdc00) {
+			text_mark(p, 4, GLYPH(0x10000 + ((u - 0xd800) << 10) + (v - 0xdc00), 4));
+			p += 4;
+		} else if ((u & 0xf800) == 0xd800) {
+			text_mark(p, 2, GLYPH_BAD | GLYPH(0, 2));
+			p += 2;
+		} else {
+			text_mark(p, 2, GLYPH(u, 2));
+			p += 2;
+		}
+	}
+#undef UNIT
+}
+
+/* decodes the row at `row` for column c */
+static void text_decode(LAYOUT *l, COLUMN *c, size_t row)
+{
+	size_t lo, hi, n;
+	uint32_t *g;
+
+	n = min(l->width, l->len - row);
+	if (n > text_cap) {
+		g = realloc(text_glyph, n * sizeof(*g));
+		if (!g) {
+			text_col = NULL;
+			return;
+		}
+		text_glyph = g;
+		text_cap   = n;
+	}
+	text_col = c;
+	text_row = row;
+	text_n   = n;
+
+	lo = row > TEXT_REACH ? row - TEXT_REACH : 0;
+	hi = min(row + n + TEXT_REACH, l->len);
+	lpin(l, lo, hi - lo);
+	if (c->text == TEXT_UTF8) text_utf8(l->data, lo, hi);
+	else                      text_utf16(l->data, lo, hi, c->text == TEXT_UTF16BE);
+	lunpin(l, lo, hi - lo);
+}
+
+/* forgets the decoded row, whenever the data or the view may have moved */
+static void text_forget(void)
+{
+	text_col = NULL;
+}
+
+/* how many cells glyph g draws across, with `room` left in its row;
+   0 for those drawn as '.' */
+static int text_width(uint32_t g, size_t room)
+{
+	uint32_t cp;
+	int w;
+
+	if (g & (GLYPH_CONT | GLYPH_BAD)) return 0;
+	cp = GLYPH_CP(g);
+	if (cp < 0x20 || (cp >= 0x7f && cp < 0xa0)) return 0;
+	w = wcwidth(cp);
+	if (w < 0 || (size_t)w > room || (size_t)w > GLYPH_LEN(g)) return 0;
+	return w ? w : 1; /* combining marks go on a dotted circle */
+}
+
+/* the glyph for the octet at `at`, decoding its row as needed */
+static uint32_t *text_at(LAYOUT *l, COLUMN *c, size_t at)
+{
+	size_t row;
+
+	row = lrow(l, at);
+	if (text_col != c || text_row != row) text_decode(l, c, row);
+	if (text_col != c) return NULL;
+	return &text_glyph[at - row];
+}
+
+/* true if the octets at a and b are part of the same sequence */
+static int text_same(LAYOUT *l, COLUMN *c, size_t a, size_t b)
+{
+	uint32_t *g;
+
+	if (a > b) return text_same(l, c, b, a);
+	if (lrow(l, a) != lrow(l, b)) return 0;
+	if (!(g = text_at(l, c, b))) return a == b;
+	for (; b > a && (*g & GLYPH_CONT); b--, g--)
+		;
+	return a == b;
+}
+
+/* draws the cell for the octet at `at` */
+static void text_cell(LAYOUT *l, COLUMN *c, size_t at)
+{
+	uint32_t *g;
+	wchar_t wc[3];
+	cchar_t cc;
+	int w;
+
+	if (!(g = text_at(l, c, at))) {
+		waddch(c->win, '.');
+		return;
+	}
+	if (*g & GLYPH_CONT) {
+		/* the right half of a wide glyph is already drawn */
+		if (at > text_row && text_width(g[-1], text_row + text_n - at + 1) == 2) return;
+		waddch(c->win, ' ');
+		return;
+	}
+
+	w = text_width(*g, text_row + text_n - at);
+	if (w == 0) {
+		waddch(c->win, '.');
+		return;
+	}
+	if (GLYPH_CP(*g) < 0x80) {
+		waddch(c->win, GLYPH_CP(*g));
+		return;
+	}
+	if (wcwidth(GLYPH_CP(*g)) == 0) {
+		wc[0] = 0x25cc; wc[1] = GLYPH_CP(*g); wc[2] = 0;
+	} else {
+		wc[0] = GLYPH_CP(*g); wc[1] = 0;
+	}
+	setcchar(&cc, wc, 0, 0, NULL);
+	wadd_wch(c->win, &cc);
+}
+/* }}} */
+/* drawing functions {{{ */
+/* draws the octet at l->offset + j, with the cursor and region marks */
+static void drawcell(LAYOUT *l, COLUMN *c, size_t j, int cursor)
+{
+	ANNOT *note;
+	attr_t a;
+
+	if (c->text && !cursor) {
+		/* a character is highlighted across all of its octets */
+		cursor = text_same(l, c, l->offset + j, l->offset + l->pos);
+	}
+	a = cursor ? C_CURSOR : 0;
+	if (!cursor && l->marking && l->offset + j >= min(l->mark, l->offset + l->pos)
+	                          && l->offset + j <= max(l->mark, l->offset + l->pos)) {
+		a = C_SELECT;
+	} else if (!cursor && l->ndirty && ldirty(l, l->offset + j)) {
+		a = C_PATCH;
+	} else if (!cursor && l->annots && (note = annot_at(l->annots, l->offset + j)) && note->color) {
+		a = C_NOTE(note->color);
+	}
+	if (l->index && l->index->job.done && ix_boundary(l->index, l->offset + j)) {
+		a |= A_UNDERLINE; /* a segment or section starts here */
+	}
+	if (a) wattron(c->win, a);
+	if (c->text) text_cell(l, c, l->offset + j);
+	else (*c->pr)(c->win, c->keyed ? unkey(l, *DATA_AT(l, j)) : *DATA_AT(l, j));
+	if (a) wattroff(c->win, a);
+}
+
+/* draws a sparse file row by row, collapsing holes to a marker row
+   (labelled in the first column) */
+static void drawrows(LAYOUT *l, COLUMN *c)
+{
+	size_t row, next, at, cur, a, b;
+	char label[64];
+	int y, w;
+
+	cur = l->offset + l->pos;
+	w   = c->width * l->width;
+	for (y = 0, row = l->offset; y < l->main_height && row < l->len; y++, row = next) {
+		wmove(c->win, y, 0);
+		if (!lhole(l, row, &a, &b)) {
+			next = row + l->width;
+			for (at = row; at < next && at < l->len; at++) {
+				drawcell(l, c, at - l->offset, at == cur);
+			}
+			continue;
+		}
+
+		next = b;
+		if (c != &l->columns[0]) continue;
+		snprintf(label, sizeof(label), "~~ hole: %zu octets ~~", b - a);
+		wattron(c->win, cur >= a && cur < b ? C_CURSOR : A_DIM);
+		wprintw(c->win, "%-*.*s", w, w, label);
+		wattroff(c->win, cur >= a && cur < b ? C_CURSOR : A_DIM);
+	}
+}
+
+void draw(LAYOUT *l)
+{
+	int i, j, max;
+
+	lview(l);
+	if (l->pane == P_HITS) {
+		hdraw(l);
+		statusbar(l);
+		frame();
+		return;
+	}
+	if (l->pane == P_STRINGS) {
+		sdraw(l);
+		statusbar(l);
+		frame();
+		return;
+	}
+	if (l->pane == P_PLOT) {
+		pdraw(l);
+		statusbar(l);
+		frame();
+		return;
+	}
+	if (l->table) {
+		tdraw(l);
+		statusbar(l);
+		frame();
+		return;
+	}
+
+	max = l->width * l->main_height;
+	if (max > l->len - l->offset) {
+		max = l->len - l->offset;
+	}
+
+	text_forget();
+	if (l->annots) annot_paint(l->annots, l->offset, max);
+	for (i = 0; i < l->ncol; i++) {
+		werase(l->columns[i].win); /* not wclear(): that repaints it all */
+		if (l->extents) {
+			drawrows(l, &l->columns[i]);
+		} else {
+			for (j = 0; j < max; j++) {
+				drawcell(l, &l->columns[i], j, j == l->pos);
+			}
+		}
+		wnoutrefresh(l->columns[i].win);
+	}
+
+	statusbar(l);
+	recpanel(l);
+	frame();
+}
+/* }}} */
+/* movement functions {{{ */
+/* pages through a sparse file, a screen of rows (holes and all) at
+   a time, keeping the cursor on the same row of the screen */
+static void lsparsepage(LAYOUT *l, int delta)
 {
-	int i;
-	uint64_t v;
-	LAYOUT *l;
+	size_t cur, col;
+	int y, yc;
+
+	cur = l->offset + l->pos;
+	col = cur % l->width;
+	yc  = max(lrows_to(l, l->offset, lrow(l, cur)), 0);
+	for (y = 0; y < abs(delta) * l->main_height; y++) {
+		if (delta > 0 && lrow_next(l, l->offset) >= l->len) break;
+		if (delta < 0 && l->offset == 0) break;
+		l->offset = delta > 0 ? lrow_next(l, l->offset) : lrow_prev(l, l->offset);
+	}
 
-	l = (LAYOUT *)_;
+	for (cur = l->offset, y = 0; y < yc && lrow_next(l, cur) < l->len; y++) {
+		cur = lrow_next(l, cur);
+	}
+	l->pos = min(cur + col, l->len - 1) - l->offset;
+	draw(l);
+}
 
-	switch (width) {
-	case 8:
-	case 16:
-	case 32:
-	case 64: break;
-	default:
-		wprintw(l->status, "!!!");
+/* puts the cursor on `new`, in a sparse file, scrolling by rows (holes
+   and all) to keep it on the screen */
+static void lsparsegoto(LAYOUT *l, size_t new)
+{
+	size_t row;
+	int rows;
+
+	row = lrow(l, new);
+	if (row < l->offset) {
+		l->offset = row;
+	} else if (lrows_to(l, l->offset, row) < 0) {
+		for (l->offset = row, rows = 0; rows < l->main_height - 2; rows++) {
+			l->offset = lrow_prev(l, l->offset);
+		}
+	}
+	l->pos = new - l->offset;
+	draw(l);
+}
+
+/* moves through a sparse file by octets; a sideways step off a hole's
+   marker row leaves the hole */
+static void lsparsemove(LAYOUT *l, long delta)
+{
+	size_t cur, a, b;
+	long new;
+
+	cur = l->offset + l->pos;
+	if (lhole(l, cur, &a, &b) && labs(delta) < l->width) {
+		delta += delta > 0 ? (long)(b - cur) - 1 : -(long)(cur - a) + 1;
+	}
+	new = max(min((long)cur + delta, (long)l->len - 1), 0);
+	if (new != cur) lsparsegoto(l, new);
+}
+
+void lpage(LAYOUT *l, int delta)
+{
+	int page = l->width * l->main_height;
+
+	if (l->extents) {
+		lsparsepage(l, delta);
 		return;
 	}
 
-	for (i = 0; i < width / 8; i++) {
-		v = as_u8(DATA_AT(l, l->pos + i));
-		if (i != 0) waddch(l->status, ' ');
-		waddch(l->status, (v & 0x80) ? '1' : '0');
-		waddch(l->status, (v & 0x40) ? '1' : '0');
-		waddch(l->status, (v & 0x20) ? '1' : '0');
-		waddch(l->status, (v & 0x10) ? '1' : '0');
-		waddch(l->status, ' ');
-		waddch(l->status, (v & 0x08) ? '1' : '0');
-		waddch(l->status, (v & 0x04) ? '1' : '0');
-		waddch(l->status, (v & 0x02) ? '1' : '0');
-		waddch(l->status, (v & 0x01) ? '1' : '0');
+	delta *= page;
+	if (delta < 0) {
+		if (-1 * delta > l->offset) {
+			l->offset = 0;
+			draw(l);
+			return;
+		}
+	} else if (l->offset + delta > (l->len + 1) - ((l->len + 1) % page)) {
+		l->offset = (l->len + 1) - ((l->len + 1) % page);
+		draw(l);
+		return;
+	}
+
+	l->offset += delta;
+	if (l->offset >= l->len) {
+		l->offset = l->len - 1;
+	}
+	draw(l);
+}
+
+void lmove(LAYOUT *l, long delta)
+{
+	int i, x, y;
+	long new, max;
+
+	if (l->extents) {
+		lsparsemove(l, delta);
+		return;
+	}
+
+	/* FIXME: assuming no need for page shifting */
+	new = l->offset + l->pos + delta;
+	if (new >= l->len) delta = l->len - (l->offset + l->pos) - 1;
+	if (delta == 0 || new < 0) return;
+
+	new = l->pos + delta;
+	max = (l->main_height - 1) * l->width;
+	if (new < 0 || new >= max) {
+		while (new < 0 && l->offset >= l->width) { /* page up */
+			l->offset -= l->width;
+			new += l->width;
+		}
+		while (new >= max) { /* page down */
+			l->offset += l->width;
+			new -= l->width;
+		}
+		l->pos = new;
+		draw(l);
+		return;
+	}
+	if (l->marking) { /* the selection grows or shrinks by the octets between */
+		l->pos = new;
+		draw(l);
+		return;
+	}
+	for (i = 0; i < l->ncol; i++) {
+		if (l->columns[i].text) { /* the cursor may span several cells */
+			l->pos = new;
+			draw(l);
+			return;
+		}
+	}
+
+	y = l->pos / l->width;
+
+	for (i = 0; i < l->ncol; i++) {
+		x = (l->pos - (y * l->width)) * l->columns[i].width;
+		wmove(l->columns[i].win, y, x);
+		drawcell(l, &l->columns[i], l->pos, 0);
+	}
+	l->pos += delta;
+	y = l->pos / l->width;
+	for (i = 0; i < l->ncol; i++) {
+		x = (l->pos - (y * l->width)) * l->columns[i].width;
+		wmove(l->columns[i].win, y, x);
+		drawcell(l, &l->columns[i], l->pos, 1);
+		wnoutrefresh(l->columns[i].win);
+	}
+
+	statusbar(l);
+	recpanel(l);
+	frame();
+}
+
+/* moves up (rows < 0) or down by rows; in a sparse file, a collapsed
+   hole counts as one */
+void lvmove(LAYOUT *l, long rows)
+{
+	size_t cur, row;
+
+	if (!l->extents) {
+		lmove(l, rows * l->width);
+		return;
+	}
+	cur = l->offset + l->pos;
+	for (row = lrow(l, cur); rows > 0 && lrow_next(l, row) < l->len; rows--) row = lrow_next(l, row);
+	for (; rows < 0 && row > 0; rows++) row = lrow_prev(l, row);
+	if (row + cur % l->width != cur) lsparsegoto(l, min(row + cur % l->width, l->len - 1));
+}
+
+/* moves the cursor by bits; the status fields read from the cursor
+   bit onwards, as if the file started there */
+void lbit(LAYOUT *l, long delta)
+{
+	long at, was;
+
+	was = l->offset + l->pos;
+	at  = was * 8 + l->bit + delta;
+	if (at < 0) at = 0;
+	if (at > (long)l->len * 8 - 1) at = (long)l->len * 8 - 1;
+
+	l->bit = at % 8;
+	if (at / 8 != was) {
+		lmove(l, at / 8 - was);
+		return;
+	}
+	statusbar(l);
+	recpanel(l);
+	frame();
+}
+
+/* jumps to the start of the next (dir > 0) or previous data extent */
+void lextent(LAYOUT *l, int dir)
+{
+	size_t cur, i;
+
+	if (!l->extents) {
+		errorf(l, "%s has no holes", l->file);
+		return;
+	}
+	cur = l->offset + l->pos;
+	for (i = 0; i < l->nextents && l->extents[i].start <= cur; i++);
+	if (dir < 0) {
+		/* back to the start of this extent, or the one before */
+		if (i && l->extents[i - 1].start == cur) i--;
+		if (!i) {
+			errorf(l, "No data before offset %zu", cur);
+			return;
+		}
+		i--;
+	} else if (i == l->nextents) {
+		errorf(l, "No data after offset %zu", cur);
+		return;
+	}
+	lgoto(l, l->extents[i].start);
+	draw(l);
+	notef(l, "Data extent %zu of %zu: %zu octets", i + 1, l->nextents,
+		l->extents[i].end - l->extents[i].start);
+}
+
+/* jumps to the next (dir > 0) or previous copy of the block under the
+   cursor, looking for duplicates first if that hasn't been done */
+void ldupjump(LAYOUT *l, int dir)
+{
+	DUPS *d;
+	DUPBLOCK *b;
+	size_t k;
+
+	if (!l->dups) {
+		ldups(l);
+		notef(l, "Looking for duplicate blocks...");
+		return;
+	}
+	d = ldups(l);
+	if (!d) {
+		errorf(l, "Still looking for duplicate blocks [%zu%%]",
+			l->dups->job.total ? l->dups->job.progress * 100 / l->dups->job.total : 0);
+		return;
+	}
+	b = dup_at(d, l->offset + l->pos);
+	if (!b) {
+		errorf(l, d->level ? "No copies of this block (1 in %d blocks sampled)"
+		                   : "No copies of this block", 1 << d->level);
+		return;
+	}
+
+	k = (b - d->blk) - b->first;
+	k = b->first + (k + b->count + (dir > 0 ? 1 : -1)) % b->count;
+	lgoto(l, DUP_AT(d->blk[k].at));
+	draw(l);
+	notef(l, "Copy %zu of %u of this %zu-octet block", k - b->first + 1, b->count,
+		(size_t)DUP_LEN(b->at));
+}
+/* }}} */
+/* searching functions {{{ */
+typedef int (*preview_fn)(LAYOUT *, const char *, void *);
+
+/* reads a line of input for `type` (:, / or ?) into buf; Esc cancels.
+   If there's a preview function, it gets the input as it's typed, and
+   returns non-zero if it's no good (which shows, in the prompt) */
+int query(LAYOUT *l, char type, char *buf, size_t len, preview_fn preview, void *udata)
+{
+	WINDOW *win;
+	size_t n;
+	int c, bad;
+
+	win = newwin(1, COLS, LINES - 1, 0);
+	waddch(win, type);
+
+	n = bad = 0;
+	timeout(-1);
+	for (;;) {
+		touchwin(win); /* previews draw all over it */
+		wrefresh(win);
+		c = getch();
+		if (c == KEY_ENTER || c == '\n' || c == '\r') {
+			/* we can re-use the last query ... */
+			if (n > 0) buf[n] = '\0';
+			delwin(win);
+			return 0;
+		}
+		if (c == 27) {
+			werase(win);
+			wrefresh(win);
+			delwin(win);
+			errno = ECANCELED;
+			return -1;
+		}
+		if (c == KEY_BACKSPACE || c == 127 || c == 8) {
+			if (n == 0) continue;
+			n--;
+		} else if (c < 256 && isprint(c)) {
+			buf[n++] = c;
+			if (n == len) {
+				delwin(win);
+				errno = ENOBUFS;
+				return -1; /* error! */
+			}
+		} else {
+			continue;
+		}
+
+		if (preview) {
+			buf[n] = '\0';
+			bad = (*preview)(l, buf, udata);
+		}
+		werase(win);
+		waddch(win, type);
+		if (bad) wattron(win, C_ERROR);
+		waddnstr(win, buf, n);
+		if (bad) wattroff(win, C_ERROR);
+	}
+}
+
+/* Keyed searches find a needle hidden under any single-octet key.
+   XOR and ADD keys cancel out of the differences between neighbouring
+   octets (c[i] ^ c[i+1] == p[i] ^ p[i+1], whatever the key), so one
+   pass comparing those differences finds every key at once; the key
+   itself is then just c[0] ^ p[0] (or c[0] - p[0]).  Rotations don't
+   cancel out like that, so ROL keys are tried directly, starting from
+   the rotations that turn p[0] into the octet at hand. */
+/* the family (KEY_*) of the key hiding the needle at d, or 0 */
+static int keymatch(PATTERN *p, const uint8_t *d, uint8_t *key)
+{
+	size_t i;
+	int r, rots;
+
+	if (p->kind == PAT_XOR || p->kind == PAT_KEYED) {
+		for (i = 0; i + 1 < p->len && (uint8_t)(d[i] ^ d[i + 1]) == p->dx[i]; i++);
+		if (i + 1 == p->len) {
+			*key = d[0] ^ p->bytes[0];
+			return KEY_XOR;
+		}
+	}
+	if (p->kind == PAT_ADD || p->kind == PAT_KEYED) {
+		for (i = 0; i + 1 < p->len && (uint8_t)(d[i + 1] - d[i]) == p->da[i]; i++);
+		if (i + 1 == p->len) {
+			*key = d[0] - p->bytes[0];
+			return KEY_ADD;
+		}
+	}
+	if (p->kind == PAT_ROL || p->kind == PAT_KEYED) {
+		for (rots = p->rot[d[0]], r = 0; rots; rots >>= 1, r++) {
+			if (!(rots & 1)) continue;
+			for (i = 1; i < p->len && rol8(p->bytes[i], r) == d[i]; i++);
+			if (i == p->len) {
+				*key = r;
+				return KEY_ROL;
+			}
+		}
+	}
+	return 0;
+}
+
+int keysearch(PATTERN *p, const uint8_t *d, long a, long b, int step, long *out)
+{
+	uint8_t key;
+
+	for (; a >= 0 && a != b; a += step) {
+		if (keymatch(p, d + a, &key)) {
+			*out = a;
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/* Bit searches look for a string of bits at any bit offset: the
+   needle is shifted into each of the 8 positions it can start at
+   within an octet (with masks for the partial octets at either end),
+   and the first 8 octets of every shift are compared a word at a
+   time, against one load of the text. */
+static int bit_compile(LAYOUT *l, PATTERN *p, const char *s)
+{
+	int n, t, s8, at;
+
+	memset(p->bpat, 0, sizeof(p->bpat));
+	memset(p->bmsk, 0, sizeof(p->bmsk));
+	for (n = 0; *s; s++) {
+		if (*s == ' ' || *s == '_') continue;
+		if (*s != '0' && *s != '1') {
+			errorf(l, "Bit searches are made of 0s and 1s, not '%c'", *s);
+			return -1;
+		}
+		if (n == BITS_MAX) {
+			errorf(l, "Bit searches are limited to %d bits", BITS_MAX);
+			return -1;
+		}
+		for (s8 = 0; s8 < 8; s8++) {
+			at = s8 + n;
+			p->bmsk[s8][at / 8] |= 0x80 >> (at % 8);
+			if (*s == '1') p->bpat[s8][at / 8] |= 0x80 >> (at % 8);
+		}
+		n++;
+	}
+	if (n == 0) {
+		errorf(l, "No search query provided.");
+		return -1;
+	}
+	for (t = 0; t < 8; t++) {
+		p->blen[t] = (t + n + 7) / 8;
+	}
+	p->len = p->blen[0];
+	p->k   = 1; /* the last shift can reach one octet further */
+	return 0;
+}
+
+int bitsearch(PATTERN *p, const uint8_t *d, size_t lim, long a, long b, int step, long *out)
+{
+	uint64_t w, m[8], v[8];
+	int s, s0, i;
+
+	for (s = 0; s < 8; s++) {
+		memcpy(&m[s], p->bmsk[s], 8);
+		memcpy(&v[s], p->bpat[s], 8);
+	}
+
+	for (; a >= 0 && a != b; a += step) {
+		w = 0;
+		memcpy(&w, d + a, min(lim - a, 8));
+		for (s0 = 0; s0 < 8; s0++) {
+			s = step > 0 ? s0 : 7 - s0;
+			if ((w & m[s]) != v[s] || a + p->blen[s] > lim) continue;
+			if (a == p->skip_at && (p->skip_bits & (1 << s))) continue;
+
+			for (i = 8; i < p->blen[s] && (d[a + i] & p->bmsk[s][i]) == p->bpat[s][i]; i++);
+			if (i < p->blen[s]) continue;
+
+			*out = a;
+			p->hit_bit = s;
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/* Mask searches are hex octets, with '?' for a nibble that can be
+   anything: \m:7f ?? 4c 4? matches 7f 00 4c 46 and 7f ff 4c 4f alike.
+   They share the bit search's first-shift pattern and mask. */
+static int mask_compile(LAYOUT *l, PATTERN *p, const char *s)
+{
+	int n, v;
+
+	memset(p->bpat, 0, sizeof(p->bpat));
+	memset(p->bmsk, 0, sizeof(p->bmsk));
+	for (n = 0; *s; s++) {
+		if (isspace((unsigned char)*s)) continue;
+		if (*s != '?' && !isxdigit((unsigned char)*s)) {
+			errorf(l, "Mask searches are made of hex digits and ?s, not '%c'", *s);
+			return -1;
+		}
+		if (n == 2 * BITS_MAX / 8) {
+			errorf(l, "Mask searches are limited to %d octets", BITS_MAX / 8);
+			return -1;
+		}
+		v = isdigit((unsigned char)*s) ? *s - '0' : tolower(*s) - 'a' + 10;
+		if (*s != '?') {
+			p->bmsk[0][n / 2] |= 0xf << (n % 2 ? 0 : 4);
+			p->bpat[0][n / 2] |= v   << (n % 2 ? 0 : 4);
+		}
+		n++;
+	}
+	if (n == 0 || n % 2) {
+		errorf(l, n ? "Mask searches need whole octets" : "No search query provided.");
+		return -1;
+	}
+	p->len = n / 2;
+	return 0;
+}
+
+int masksearch(PATTERN *p, const uint8_t *d, long a, long b, int step, long *out)
+{
+	size_t i;
+
+	for (; a >= 0 && a != b; a += step) {
+		for (i = 0; i < p->len && (d[a + i] & p->bmsk[0][i]) == p->bpat[0][i]; i++);
+		if (i == p->len) {
+			*out = a;
+			return 0;
+		}
 	}
-} /* }}} */
-static void fmt_E(void *_, int width, void *_field) /* {{{ */
+	return 1;
+}
+
+/* Search queries are plain text, unless they start with a backslash
+   and a letter, which picks another kind of pattern; a number after
+   the letter parameterizes it, and a colon ends the prefix:
+
+       \h2:needle   at most 2 octets differ (Hamming distance)
+       \e1:needle   at most 1 insertion, deletion or substitution
+       \x:needle    under any XOR key (\a: ADD, \r: ROL, \k: any)
+       \b:0110101   those bits, at any bit offset
+       \m:7f ?? 4c  those octets, any nibble marked '?' aside
+       \\needle     plain text, starting with a backslash */
+int pat_compile(LAYOUT *l, PATTERN *p, const char *q)
 {
-	LAYOUT *l;
-	uint8_t buf[2] = { 0xba, 0xab };
+	const char *s;
+	char *end;
+	size_t i;
+
+	memset(p, 0, sizeof(PATTERN));
+	p->kind = PAT_EXACT;
+	s = q;
+	if (s[0] == '\\' && s[1] == '\\') {
+		s++;
+
+	} else if (s[0] == '\\' && isalpha((unsigned char)s[1])) {
+		switch (s[1]) {
+		case 'h': p->kind = PAT_HAMMING; break;
+		case 'e': p->kind = PAT_EDIT;    break;
+		case 'x': p->kind = PAT_XOR;     break;
+		case 'a': p->kind = PAT_ADD;     break;
+		case 'r': p->kind = PAT_ROL;     break;
+		case 'k': p->kind = PAT_KEYED;   break;
+		case 'b': p->kind = PAT_BITS;    break;
+		case 'm': p->kind = PAT_MASK;    break;
+		default:
+			errorf(l, "Unknown search type: \\%c", s[1]);
+			return -1;
+		}
+		p->k = 1;
+		if (isdigit((unsigned char)s[2])) p->k = strtol(s + 2, &end, 10);
+		else                              end = (char *)s + 2;
+		if (*end != ':') {
+			errorf(l, "Search types look like \\%c2:needle", s[1]);
+			return -1;
+		}
+		s = end + 1;
+	}
+	p->skip_at = -1;
+	if (p->kind == PAT_BITS) return bit_compile(l, p, s);
+	if (p->kind == PAT_MASK) return mask_compile(l, p, s);
 
-	l = (LAYOUT *)_;
-	if (as_u16(buf) == 0xbaab) {
-		     if (width == 1) wprintw(l->status, "B");
-		else if (width == 2) wprintw(l->status, "BE");
-		else if (width == 3) wprintw(l->status, "big");
-		else if (width == 0) wprintw(l->status, "big-endian");
-		else                 wprintw(l->status, "!!!");
-	} else {
-		     if (width == 1) wprintw(l->status, "L");
-		else if (width == 2) wprintw(l->status, "LE");
-		else if (width == 3) wprintw(l->status, "lil");
-		else if (width == 0) wprintw(l->status, "little-endian");
-		else                 wprintw(l->status, "!!!");
+	p->bytes = (const uint8_t *)s;
+	p->len   = strlen(s);
+	if (p->len == 0) {
+		errorf(l, "No search query provided.");
+		return -1;
 	}
-} /* }}} */
-static void fmt_o(void *_, int width, void *_field) /* {{{ */
+	if (p->kind == PAT_EXACT) return 0;
+
+	if (p->len > 64) {
+		errorf(l, "Fuzzy and keyed searches are limited to 64 octets");
+		return -1;
+	}
+	if (p->kind >= PAT_XOR) {
+		if (p->len < 2) {
+			errorf(l, "Keyed searches need at least 2 octets");
+			return -1;
+		}
+		for (i = 0; i + 1 < p->len; i++) {
+			p->dx[i] = p->bytes[i] ^ p->bytes[i + 1];
+			p->da[i] = p->bytes[i + 1] - p->bytes[i];
+		}
+		for (i = 0; i < 8; i++) {
+			p->rot[rol8(p->bytes[0], i)] |= 1 << i;
+		}
+		p->k = 0;
+		return 0;
+	}
+	if (p->k >= p->len) {
+		errorf(l, "Allowing %d differences would match anything", p->k);
+		return -1;
+	}
+	for (i = 0; i < p->len; i++) {
+		p->eq[0][p->bytes[i]]              |= 1ULL << i;
+		p->eq[1][p->bytes[p->len - 1 - i]] |= 1ULL << i;
+	}
+	return 0;
+}
+
+/* the shortest run of octets the pattern can match */
+static size_t pat_min(PATTERN *p)
 {
-	LAYOUT *l;
+	return p->kind == PAT_EDIT ? p->len - p->k : p->len;
+}
 
-	l = (LAYOUT *)_;
-	wprintw(l->status, "%ld", l->offset + l->pos);
-} /* }}} */
-static void fmt_l(void *_, int width, void *_field) /* {{{ */
+/* how far past an anchor a match (or its alignment) may reach */
+static size_t pat_reach(PATTERN *p)
 {
-	LAYOUT *l;
+	return p->len + p->k;
+}
 
-	l = (LAYOUT *)_;
-	wprintw(l->status, "%ld", l->len);
-} /* }}} */
-static void fmt_F(void *_, int width, void *_field) /* {{{ */
+/* plain edit distance, between the pattern and t[0 .. n) */
+static int editdist(PATTERN *p, const uint8_t *t, size_t n)
 {
-	LAYOUT *l;
+	int col[65], diag, up, i, j;
+
+	for (i = 0; i <= p->len; i++) col[i] = i;
+	for (j = 0; j < n; j++) {
+		diag = col[0];
+		col[0] = j + 1;
+		for (i = 1; i <= p->len; i++) {
+			up = col[i];
+			col[i] = min(min(col[i] + 1, col[i - 1] + 1), diag + (p->bytes[i - 1] != t[j]));
+			diag = up;
+		}
+	}
+	return col[p->len];
+}
 
-	l = (LAYOUT *)_;
-	wprintw(l->status, "%s", l->file);
-} /* }}} */
-static void fmt_P(void *_, int width, void *_field) /* {{{ */
+/* where the closest match ending at e starts (leftmost, on ties) */
+static long fz_start(PATTERN *p, const uint8_t *d, long e)
 {
-	LAYOUT *l;
+	long s, best;
+	int dist, bestd;
 
-	l = (LAYOUT *)_;
-	wprintw(l->status, "%s", l->path);
-} /* }}} */
-static void fmt_T(void *_, int width, void *_field) /* {{{ */
+	best = -1; bestd = INT_MAX;
+	for (s = max(e + 1 - (long)pat_reach(p), 0); s <= e + 1 - (long)pat_min(p); s++) {
+		dist = editdist(p, d + s, e + 1 - s);
+		if (dist < bestd) { best = s; bestd = dist; }
+	}
+	return best;
+}
+
+/* where the closest match starting at s ends (shortest, on ties) */
+static long fz_end(PATTERN *p, const uint8_t *d, size_t lim, long s)
 {
-	int left, i;
-	LAYOUT *l;
-	char *s, *p;
-	time_t t;
+	long e, best;
+	int dist, bestd;
 
-	l = (LAYOUT *)_;
-	left = l->len - (l->offset + l->pos);
+	best = -1; bestd = INT_MAX;
+	for (e = s + pat_min(p) - 1; e < min(s + (long)pat_reach(p), (long)lim); e++) {
+		dist = editdist(p, d + s, e + 1 - s);
+		if (dist < bestd) { best = e; bestd = dist; }
+	}
+	return best;
+}
 
-	if (left >= 4) {
-		//Wed Jun 30 21:49:08 1993\n
-		t = as_u32(DATA_AT(l, l->pos));
-		s = ctime(&t);
-		if (s) {
-			p = strchr(s, '\n');
-			if (p) *p = '\0';
-			wprintw(l->status, "%24s", s);
-		} else {
-			wprintw(l->status, "%24s", "-");
+/* Approximate matching, bit-parallel: bit i of a state word tracks a
+   match of the first i + 1 pattern octets, so every alignment of a
+   pattern of up to 64 octets advances with a few word operations per
+   text octet.  Hamming distance uses shift-and with one state word
+   per mismatch allowed; edit distance uses Myers' algorithm.  Going
+   backwards, the reversed pattern is matched against the text read
+   from right to left, so that what comes out is a match's start.
+
+   Anchors (match starts) run from a towards b, exclusive, as they do
+   for searchin(); d[0 .. lim) is all there is to read. */
+int fzsearch(PATTERN *p, const uint8_t *d, size_t lim, long a, long b, int step, long *out)
+{
+	const uint64_t *eq;
+	uint64_t r[65], old, prev, hb, x, pv, mv, xv, xh, ph, mh;
+	long i, to, s, e;
+	int j, score;
+
+	eq = p->eq[step < 0];
+	hb = 1ULL << (p->len - 1);
+	if (step > 0) {
+		i  = a;
+		to = min(b - 1 + (long)pat_reach(p), (long)lim);
+	} else {
+		i  = min(a + (long)pat_reach(p) - 1, (long)lim - 1);
+		to = max(b, -1);
+	}
+	if (i < 0 || (step > 0 ? i >= to : i <= to)) return 1;
+
+	if (p->kind == PAT_HAMMING) {
+		memset(r, 0, sizeof(r));
+		for (; i != to; i += step) {
+			x = eq[d[i]];
+			prev = 0;
+			for (j = 0; j <= p->k; j++) {
+				old  = r[j];
+				r[j] = ((r[j] << 1 | 1) & x) | (j ? prev << 1 | 1 : 0);
+				prev = old;
+			}
+			if (!(r[p->k] & hb)) continue;
+
+			s = step > 0 ? i - (long)p->len + 1 : i;
+			if (step > 0 ? s >= b : s > a) continue; /* outside this window */
+			*out = s;
+			return 0;
 		}
+		return 1;
 	}
-	for (i = 0; i < width; i++) {
-		if (i != 0) waddch(l->status, ' ');
-		if (i > left) {
-			waddch(l->status, ' ');
-			waddch(l->status, ' ');
+
+	pv = ~0ULL; mv = 0; score = p->len;
+	for (; i != to; i += step) {
+		x  = eq[d[i]];
+		xv = x | mv;
+		xh = (((x & pv) + pv) ^ pv) | x;
+		ph = mv | ~(xh | pv);
+		mh = pv & xh;
+		if      (ph & hb) score++;
+		else if (mh & hb) score--;
+		ph <<= 1;
+		mh <<= 1;
+		pv = mh | ~(xv | ph);
+		mv = ph & xv;
+		if (score > p->k) continue;
+
+		/* a match ends (or, backwards, starts) here; only report it
+		   from the anchor its best alignment starts at, so that
+		   repeating the search doesn't land on the same match,
+		   shifted along by an insertion or deletion */
+		if (step > 0) {
+			s = fz_start(p, d, i);
+			if (s < a || s >= b) continue;
 		} else {
-			wprintw(l->status, "%02x", as_u8(DATA_AT(l, l->pos + i)));
+			e = fz_end(p, d, lim, i);
+			s = e < 0 ? -1 : fz_start(p, d, e);
+			if (s != i || s > a) continue;
 		}
+		*out = s;
+		return 0;
 	}
-} /* }}} */
-static void fmt_x(void *_, int width, void *_field) /* {{{ */
+	return 1;
+}
+
+int searchin(const uint8_t *haystack, long a, long b, int step, const uint8_t *needle, size_t len, long *out)
 {
-	int left, i;
-	LAYOUT *l;
+	const uint8_t *c;
+	int i, ok;
 
-	l = (LAYOUT *)_;
-	left = l->len - (l->offset + l->pos);
+	if (step == 1) { /* libc's memchr skips ahead to each candidate */
+		for (; a < b; a++) {
+			c = memchr(haystack + a, needle[0], b - a);
+			if (!c) return 1;
+			a = c - haystack;
+			if (memcmp(c + 1, needle + 1, len - 1) == 0) {
+				*out = a;
+				return 0;
+			}
+		}
+		return 1;
+	}
+	for (; a >= 0 && a != b; a += step) {
+		if (haystack[a] != (uint8_t)(needle[0])) continue;
 
-	for (i = 0; i < width; i++) {
-		if (i != 0) waddch(l->status, ' ');
-		if (i > left) {
-			waddch(l->status, ' ');
-			waddch(l->status, ' ');
-		} else {
-			wprintw(l->status, "%02x", as_u8(DATA_AT(l, l->pos + i)));
+		ok = 1;
+		for (i = 1; i < len; i++) {
+			if (haystack[a+i] != (uint8_t)(needle[i])) {
+				ok = 0;
+				break;
+			}
+		}
+		if (ok) {
+			*out = a;
+			return 0;
 		}
 	}
-} /* }}} */
-static void fmt_f(void *_, int width, void *_field) /* {{{ */
+
+	return 1;
+}
+
+static int psearch(PATTERN *p, const uint8_t *d, size_t lim, long a, long b, int step, long *out)
 {
-	int left;
-	LAYOUT *l;
+	if (p->kind == PAT_EXACT) return searchin(d, a, b, step, p->bytes, p->len, out);
+	if (p->kind == PAT_BITS)  return bitsearch(p, d, lim, a, b, step, out);
+	if (p->kind == PAT_MASK)  return masksearch(p, d, a, b, step, out);
+	if (p->kind >= PAT_XOR)   return keysearch(p, d, a, b, step, out);
+	return fzsearch(p, d, lim, a, b, step, out);
+}
 
-	l = (LAYOUT *)_;
-	left = l->len - (l->offset + l->pos);
+/* could the pattern match inside a hole? */
+static int pat_zeros(PATTERN *p)
+{
+	uint8_t *z;
+	long n, at;
+	int rc;
+
+	n = 2 * pat_reach(p);
+	z = calloc(n, 1);
+	if (!z) return 1;
+	rc = psearch(p, z, n, 0, n - pat_reach(p), 1, &at);
+	free(z);
+	return rc == 0;
+}
 
-	switch (width) {
-	case 32:
-		if (left >= 4) wprintw(l->status, "%f", as_f32(DATA_AT(l, l->pos)));
-		else           waddch(l->status, '-');
-		break;
-	case 64:
-		if (left >= 4) wprintw(l->status, "%lf", as_f64(DATA_AT(l, l->pos)));
-		else           waddch(l->status, '-');
-		break;
-	default:
-		wprintw(l->status, "!!!");
-		break;
+/* searches a window at a time, so that decoded sources only ever
+   need the window being searched (and a pattern's reach either side
+   of it) to be resident.  The holes of a sparse file are skipped,
+   unless the pattern would match their zeros. */
+/* has a key been pressed, that nobody has read yet? */
+static int keypending(void)
+{
+	int c;
+
+	nodelay(stdscr, TRUE);
+	c = getch();
+	nodelay(stdscr, FALSE);
+	if (c == ERR) return 0;
+	ungetch(c);
+	return 1;
+}
+
+/* returns 0 (and the offset) on a match, 1 if there is none, or 2 if
+   l->interruptible and a key was pressed before it could tell */
+int lsearch(LAYOUT *l, long a, long b, int step, PATTERN *p, long *out)
+{
+	long w, end, lo, hi, stop;
+	size_t fwd;
+	int rc, sparse;
+
+	rc = 1;
+	sparse = l->extents && !pat_zeros(p);
+	if (step > 0 && a < b) pf_advise(l, a, b - a, MADV_SEQUENTIAL);
+	for (w = a; step > 0 ? w < b : w > b; w = end) {
+		if (l->interruptible && keypending()) {
+			rc = 2;
+			break;
+		}
+		end = step > 0 ? min(w + SRC_CHUNK, b) : max(w - SRC_CHUNK, b);
+		if (sparse && step > 0) {
+			w = min(ext_next(l->extents, l->nextents, w, pat_reach(p), &fwd), (size_t)b);
+			if (w >= b) break;
+			end = min(min(w + SRC_CHUNK, b), (long)min(fwd, (size_t)LONG_MAX));
+		} else if (sparse) {
+			w = max(ext_prev(l->extents, l->nextents, w, pat_reach(p), &stop), b);
+			if (w <= b) break;
+			end = max(max(w - SRC_CHUNK, b), stop);
+		}
+		lo  = max(min(w, end) - (long)pat_reach(p), 0);
+		hi  = max(w, end) + pat_reach(p);
+		lpin(l, lo, hi - lo);
+		pf_count(l, lo, hi - lo);
+		if (step > 0) pf_ahead(l, hi, SRC_CHUNK);
+		else          pf_ahead(l, max(lo - SRC_CHUNK, 0), min(lo, SRC_CHUNK));
+		rc  = psearch(p, l->data, p->kind == PAT_BITS ? min(hi, (long)l->len) : l->len, w, end, step, out);
+		lunpin(l, lo, hi - lo);
+		if (rc == 0) break;
 	}
-} /* }}} */
-static void fmt_e(void *_, int width, void *_field) /* {{{ */
+	if (step > 0 && a < b) pf_advise(l, a, b - a, MADV_NORMAL);
+	return rc;
+}
+
+/* puts the cursor on a match; keyed matches also set the layout's key */
+static void found(LAYOUT *l, PATTERN *p, long at)
 {
-	int left;
-	LAYOUT *l;
+	static const char *ops[] = { "no", "XOR", "ADD", "ROL" };
+	uint8_t key;
+	int op;
+
+	l->bit = p->kind == PAT_BITS ? p->hit_bit : 0;
+	lmove(l, at - (l->offset + l->pos));
+	if (p->kind == PAT_BITS) {
+		statusbar(l); /* lmove() doesn't, if only the bit moved */
+		frame();
+		return;
+	}
+	if (p->kind < PAT_XOR) return;
 
-	l = (LAYOUT *)_;
-	left = l->len - (l->offset + l->pos);
+	lpin(l, at, p->len);
+	op = keymatch(p, l->data + at, &key);
+	lunpin(l, at, p->len);
 
-	switch (width) {
-	case 32:
-		if (left >= 4) wprintw(l->status, "%e", as_f32(DATA_AT(l, l->pos)));
-		else           waddch(l->status, '-');
-		break;
-	case 64:
-		if (left >= 4) wprintw(l->status, "%le", as_f64(DATA_AT(l, l->pos)));
-		else           waddch(l->status, '-');
-		break;
-	default:
-		wprintw(l->status, "!!!");
-		break;
+	l->keyop = op;
+	l->key   = key;
+	draw(l);
+	notef(l, "Found under %s key 0x%02x", ops[op], key);
+}
+
+void search(LAYOUT *l, char *pat)
+{
+	int rc;
+	long offset, last, from, to;
+	PATTERN p;
+
+	if (pat_compile(l, &p, pat) != 0) return;
+	last = (long)l->len - (long)pat_min(&p); /* the last place a match can start */
+
+	from = l->offset + l->pos + 1;
+	to   = from - 1;
+	if (p.kind == PAT_BITS) { /* later bits of this octet come first ... */
+		p.skip_at   = --from;
+		p.skip_bits = BITS_UPTO(l->bit);
+	}
+	rc = lsearch(l, from, last + 1, 1, &p, &offset);
+	if (rc == 0) {
+		found(l, &p, offset);
+		return;
+	}
+	if (p.kind == PAT_BITS) { /* ... and its earlier bits last */
+		p.skip_bits = BITS_FROM(l->bit);
+		to++;
+	}
+	rc = lsearch(l, 0, min(to, last + 1), 1, &p, &offset);
+	if (rc == 0) {
+		found(l, &p, offset);
+		return;
 	}
-} /* }}} */
 
-/* status bar functions {{{ */
-int parse_status(const char *s, FIELD *fields)
+	errorf(l, "Pattern not found: %s", pat);
+}
+
+void rsearch(LAYOUT *l, char *pat)
 {
-	int nfields, w;
-	const char *a, *b;
+	int rc;
+	long offset, last, from, to;
+	PATTERN p;
+
+	if (pat_compile(l, &p, pat) != 0) return;
+	last = (long)l->len - (long)pat_min(&p);
+
+	from = l->offset + l->pos - 1;
+	to   = from + 1;
+	if (p.kind == PAT_BITS) { /* earlier bits of this octet come first ... */
+		p.skip_at   = ++from;
+		p.skip_bits = BITS_FROM(l->bit);
+	}
+	rc = lsearch(l, min(from, last), -1, -1, &p, &offset);
+	if (rc == 0) {
+		found(l, &p, offset);
+		return;
+	}
+	if (p.kind == PAT_BITS) { /* ... and its later bits last */
+		p.skip_bits = BITS_UPTO(l->bit);
+		to--;
+	}
+	rc = lsearch(l, last, to, -1, &p, &offset);
+	if (rc == 0) {
+		found(l, &p, offset);
+		return;
+	}
 
-	nfields = 0;
-	a = s;
-	while (*a) { /* until we run out of string ... */
-		b = strchr(a, '%');
-		if (!b) {
-			/* trailing string literal */
-			if (fields) {
-				fields[nfields].fmt     = fmt_literal;
-				fields[nfields].width   = -1;
-				fields[nfields].literal = strdup(a);
+	errorf(l, "Pattern not found: %s", pat);
+}
+
+/* Incremental search moves to the first match as the pattern is
+   typed, always counting from where the cursor was to begin with (the
+   origin).  Every match of a longer exact needle is also a match of
+   the shorter one, so when the needle only grows, the search picks up
+   at the last match instead of going over the same ground again. */
+typedef struct {
+	int dir;             /* 1 for /, -1 for ? */
+	size_t offset, pos;  /* where the view and cursor were */
+	int bit, keyop;
+	uint8_t key;
+
+	char last[8192];     /* the needle of the last finished search ... */
+	int kind;            /* ... its PAT_* kind (-1 = none yet) ... */
+	long at;             /* ... where it matched (-1 = nowhere) ... */
+	int wrapped;         /* ... and whether that was past the wrap */
+} ISEARCH;
+
+static void isearch_home(LAYOUT *l, ISEARCH *st)
+{
+	l->offset = st->offset;
+	l->pos    = st->pos;
+	l->bit    = st->bit;
+	l->keyop  = st->keyop;
+	l->key    = st->key;
+	draw(l);
+}
+
+static int isearch_preview(LAYOUT *l, const char *q, void *_)
+{
+	ISEARCH *st;
+	PATTERN p;
+	long origin, last, from, to, at;
+	int rc, ext, resume, wrapped;
+
+	st = (ISEARCH *)_;
+	if (!*q || pat_compile(l, &p, q) != 0) {
+		st->kind = -1;
+		isearch_home(l, st);
+		return *q ? 1 : 0;
+	}
+	ext = st->kind == PAT_EXACT && p.kind == PAT_EXACT
+	   && strlen(q) > strlen(st->last) && strncmp(q, st->last, strlen(st->last)) == 0;
+	if (ext && st->at < 0) { /* nowhere to be found, then or now */
+		snprintf(st->last, sizeof(st->last), "%s", q);
+		return 1;
+	}
+
+	origin = st->offset + st->pos;
+	last   = (long)l->len - (long)pat_min(&p);
+	resume  = ext && st->wrapped; /* the last match was past the wrap */
+	wrapped = 0;
+	rc = 1;
+	if (st->dir > 0) {
+		from = origin + 1;
+		to   = origin;
+		if (p.kind == PAT_BITS) {
+			p.skip_at   = --from;
+			p.skip_bits = BITS_UPTO(st->bit);
+		}
+		if (!resume) rc = lsearch(l, ext ? st->at : from, last + 1, 1, &p, &at);
+		if (rc == 1) {
+			wrapped = 1;
+			if (p.kind == PAT_BITS) {
+				p.skip_bits = BITS_FROM(st->bit);
+				to++;
 			}
-			nfields++;
-			return nfields;
+			rc = lsearch(l, resume ? st->at : 0, min(to, last + 1), 1, &p, &at);
 		}
-		if (a != b) {
-			if (fields) {
-				fields[nfields].fmt     = fmt_literal;
-				fields[nfields].width   = -1;
-				fields[nfields].literal = calloc(b - a + 1, sizeof(char));
-				memcpy(fields[nfields].literal, a, b - a);
+	} else {
+		from = origin - 1;
+		to   = origin;
+		if (p.kind == PAT_BITS) {
+			p.skip_at   = ++from;
+			p.skip_bits = BITS_FROM(st->bit);
+		}
+		if (!resume) rc = lsearch(l, min(ext ? st->at : from, last), -1, -1, &p, &at);
+		if (rc == 1) {
+			wrapped = 1;
+			if (p.kind == PAT_BITS) {
+				p.skip_bits = BITS_UPTO(st->bit);
+				to--;
 			}
-			nfields++;
+			rc = lsearch(l, resume ? min(st->at, last) : last, to, -1, &p, &at);
 		}
+	}
+	if (rc == 2) return 0; /* more typing to do; this can wait */
+
+	snprintf(st->last, sizeof(st->last), "%s", q);
+	st->kind    = p.kind;
+	st->at      = rc == 0 ? at : -1;
+	st->wrapped = wrapped;
+	if (rc != 0) {
+		isearch_home(l, st);
+		return 1;
+	}
+	l->offset = st->offset; /* so the view moves as little as it can */
+	l->pos    = st->pos;
+	l->bit    = st->bit;
+	found(l, &p, at);
+	return 0;
+}
+
+/* / and ?, searching as the needle is typed; Enter stays on the match,
+   Esc goes back to where the search began */
+void isearch(LAYOUT *l, char type, char *q, size_t len)
+{
+	ISEARCH st;
+	char buf[8192];
+
+	memset(&st, 0, sizeof(st));
+	st.dir    = type == '/' ? 1 : -1;
+	st.offset = l->offset;
+	st.pos    = l->pos;
+	st.bit    = l->bit;
+	st.keyop  = l->keyop;
+	st.key    = l->key;
+	st.kind   = -1;
+
+	buf[0] = '\0';
+	l->interruptible = 1;
+	if (query(l, type, buf, min(len, sizeof(buf)), isearch_preview, &st) != 0) {
+		l->interruptible = 0;
+		isearch_home(l, &st);
+		return;
+	}
+	l->interruptible = 0;
+
+	if (!buf[0]) { /* the last search, again */
+		if (type == '/') search(l, q);
+		else            rsearch(l, q);
+		return;
+	}
+	snprintf(q, len, "%s", buf);
+	if (st.kind < 0 || strcmp(st.last, buf) != 0) {
+		isearch_preview(l, buf, &st); /* typed ahead of the preview */
+	}
+	if (st.kind >= 0 && st.at < 0) errorf(l, "Pattern not found: %s", buf);
+}
+/* }}} */
+
+/* table view keys; returns non-zero if the key was handled */
+int tkey(LAYOUT *l, int c, int quant)
+{
+	TABLE *t;
+	size_t n, half;
+
+	t = l->table;
+	n = quant ? quant : 1;
+	half = max((l->main_height - 2 - TABLE_FOOTER) / 2, 1);
+
+	switch (c) {
+	case KEY_UP:
+	case 'j':       t->rec = t->rec > n ? t->rec - n : 0;            break;
+	case KEY_DOWN:
+	case 'k':       t->rec = min(t->rec + n, t->nrec - 1);           break;
+	case 'U' & 037: t->rec = t->rec > half ? t->rec - half : 0;      break;
+	case 'D' & 037: t->rec = min(t->rec + half, t->nrec - 1);        break;
+	case 'G':       t->rec = quant ? min(n, t->nrec - 1) : t->nrec - 1; break;
+	case 'g':       t->rec = 0;                                      break;
+
+	case 27:
+	case 'T':
+		ltable_close(l);
+		break;
+
+	default:
+		return 0;
+	}
 
-		b++;
-		if (*b == '%') { /* '%%' */
-			a = b + 1;
-			continue;
-		}
+	draw(l);
+	return 1;
+}
 
-		w = 0;
-		while (isdigit(*b)) {
-			w = w * 10 + (*b) - '0';
-			b++;
-		}
-		if (fields) fields[nfields].width = w;
+/* strings pane keys; returns non-zero if the key was handled */
+int skey(LAYOUT *l, int c, int quant)
+{
+	STRINGS *s;
+	size_t n, half, len;
+	char old[STR_FILTER];
 
-		switch (*b) {
-		case 'u':
-			b++;
-			if (*b != 'd') {
-				printw("invalid format code '%%%du%c'\n", w, *b);
-				return -1;
-			}
-			if (fields) fields[nfields].fmt = fmt_ud;
-			break;
+	s = l->strings;
+	n = quant ? quant : 1;
+	half = max((l->main_height - 2) / 2, 1);
 
-		case 's':
-			b++;
-			if (*b != 'd') {
-				printw("invalid format code '%%%ds%c'\n", w, *b);
-				return -1;
-			}
-			if (fields) fields[nfields].fmt = fmt_sd;
+	if (s->editing) {
+		len = strlen(s->filter);
+		memcpy(old, s->filter, len + 1);
+		switch (c) {
+		case 27:
+		case '\n':
+		case KEY_ENTER:
+			s->editing = 0;
 			break;
 
-		case 'z':
-			b++;
-			switch (*b) {
-			case 'l': if (fields) fields[nfields].fmt = fmt_lz; break;
-			case 't': if (fields) fields[nfields].fmt = fmt_tz; break;
-			default:
-				printw("invalid format code '%%%dz%c'\n", w, *b);
-				return -1;
+		case KEY_BACKSPACE:
+		case 127:
+		case 8:
+			if (len == 0) {
+				s->editing = 0;
+				break;
 			}
+			s->filter[len - 1] = '\0';
+			str_refilter(s, old);
 			break;
 
-		case 'x': if (fields) fields[nfields].fmt = fmt_x; break;
-		case 'f': if (fields) fields[nfields].fmt = fmt_f; break;
-		case 'e': if (fields) fields[nfields].fmt = fmt_e; break;
-		case 'b': if (fields) fields[nfields].fmt = fmt_b; break;
-		case 'E': if (fields) fields[nfields].fmt = fmt_E; break;
-		case 'o': if (fields) fields[nfields].fmt = fmt_o; break;
-		case 'l': if (fields) fields[nfields].fmt = fmt_l; break;
-		case 'F': if (fields) fields[nfields].fmt = fmt_F; break;
-		case 'P': if (fields) fields[nfields].fmt = fmt_P; break;
-		case 'T': if (fields) fields[nfields].fmt = fmt_T; break;
-		case 'p': if (fields) fields[nfields].fmt = fmt_p; break;
-
-		case 't':
-		case 'C':
-		case 'c':
-
 		default:
-			printw("invalid format code '%%%d%c'\n", w, *b);
-			return -1;
+			if (c > 255 || !isprint(c) || len + 1 >= STR_FILTER) return 1;
+			s->filter[len] = c;
+			s->filter[len + 1] = '\0';
+			str_refilter(s, old);
+			break;
 		}
-		nfields++;
-		b++;
-
-		a = b;
+		draw(l);
+		return 1;
 	}
 
-	return nfields;
-}
+	switch (c) {
+	case KEY_UP:
+	case 'j':       s->sel = s->sel > n ? s->sel - n : 0;       break;
+	case KEY_DOWN:
+	case 'k':       s->sel += n;                                break;
+	case 'U' & 037: s->sel = s->sel > half ? s->sel - half : 0; break;
+	case 'D' & 037: s->sel += half;                             break;
+	case 'G':       s->sel = quant ? n : (size_t)-1 / 2;        break;
+	case 'g':       s->sel = 0;                                 break;
+
+	case '/':
+		s->editing = 1;
+		break;
 
-void statusbar(LAYOUT *l)
-{
-	int i;
-	werase(l->status);
-	wmove(l->status, 0, 0);
-	for (i = 0; i < l->nfields; i++) {
-		(*l->fields[i].fmt)(l, l->fields[i].width, &l->fields[i]);
+	case '\n':
+	case KEY_ENTER:
+		if (s->sel < __atomic_load_n(&s->nmatch, __ATOMIC_ACQUIRE)) {
+			lgoto(l, s->off[s->match[s->sel]]);
+		}
+		lstrings_close(l);
+		break;
+
+	case 27:
+		lgoto(l, s->home);
+		lstrings_close(l);
+		break;
+
+	default:
+		return 0;
 	}
-	wnoutrefresh(l->status);
+
+	draw(l);
+	return 1;
 }
 
-/* }}} */
-/* configuration functions {{{ */
-FILE *find_config()
+/* hit list keys; returns non-zero if the key was handled */
+int hkey(LAYOUT *l, int c, int quant)
 {
-	FILE *io;
-	char *env, path[8192];
-	int n;
+	SCAN *sc;
+	size_t n, half;
+
+	sc = l->scan;
+	n = quant ? quant : 1;
+	half = max((l->main_height - 2) / 2, 1);
+
+	switch (c) {
+	case KEY_UP:
+	case 'j':       sc->sel = sc->sel > n ? sc->sel - n : 0;       break;
+	case KEY_DOWN:
+	case 'k':       sc->sel += n;                                  break;
+	case 'U' & 037: sc->sel = sc->sel > half ? sc->sel - half : 0; break;
+	case 'D' & 037: sc->sel += half;                               break;
+	case 'G':       sc->sel = quant ? n : (size_t)-1 / 2;          break;
+	case 'g':       sc->sel = 0;                                   break;
+
+	case '\n':
+	case KEY_ENTER:
+		/* hdraw() keeps the cursor on the selected hit */
+		lscan_close(l);
+		break;
 
-	env = getenv("VEXRC");
-	if (env) {
-		io = fopen(env, "r");
-		if (io) return io;
-	}
+	case 27:
+		lgoto(l, sc->home);
+		lscan_close(l);
+		break;
 
-	env = getenv("HOME");
-	if (env) {
-		n = snprintf(path, 8192, "%s/" CONFIG_USERFILE, env);
-		if (n < 8192) {
-			io = fopen(path, "r");
-			if (io) return io;
-		}
+	default:
+		return 0;
 	}
 
-	return fopen(CONFIG_SYSFILE, "r");
+	draw(l);
+	return 1;
 }
 
-#define DEFAULT_LAYOUT "Xa"
-#define DEFAULT_STATUS "vex [%1E] +%o/%l %F ... b[ %64b ]"
-
-CONFIG* configure()
+int pkey(LAYOUT *l, int c, int quant)
 {
-	FILE *io;
-	CONFIG *c;
-	char buf[8192];
-	int line;
+	PLOT *p;
+	size_t n, step, half;
+
+	p = l->plot;
+	n = quant ? quant : 1;
+	step = (size_t)1 << p->zoom;
+	half = plot_width() / 2 * step;
+
+	switch (c) {
+	case KEY_LEFT:
+	case 'h':       p->cur = p->cur > n * step ? p->cur - n * step : 0; break;
+	case KEY_RIGHT:
+	case 'l':       p->cur = min(p->cur + n * step, p->n - 1);         break;
+	case 'U' & 037: p->cur = p->cur > half ? p->cur - half : 0;        break;
+	case 'D' & 037: p->cur = min(p->cur + half, p->n - 1);             break;
+	case 'g':       p->cur = 0;                                        break;
+	case 'G':       p->cur = quant ? min(n, p->n - 1) : p->n - 1;     break;
+	case '+':       plot_zoom(p, p->zoom - (int)n);                    break;
+	case '-':       plot_zoom(p, p->zoom + (int)n);                    break;
+	case '=':       plot_zoom(p, plot_fit(p));                         break;
+
+	case '\n':
+	case KEY_ENTER:
+		/* pdraw() keeps the cursor on the selected sample */
+		lplot_close(l);
+		break;
 
-	c = calloc(1, sizeof(CONFIG));
-	io = find_config();
-	if (!io) {
-		c->layout = strdup(DEFAULT_LAYOUT);
-		c->status = strdup(DEFAULT_STATUS);
-		return c;
-	}
+	case 27:
+		lgoto(l, p->home);
+		lplot_close(l);
+		break;
 
-	line = 0;
-	while (fgets(buf, 8192, io) != NULL) {
-		char *a, *b;
+	default:
+		return 0;
+	}
 
-		line++;
+	draw(l);
+	return 1;
+}
 
-		a = strchr(buf, '\n');
-		if (a) *a = '\0';
+/* grep mode {{{ */
+/* `vex --grep PATTERN FILE...` searches many files at once, with the
+   same patterns as / and prints a FILE:OFFSET line per match.  Each
+   worker has a deque of tasks: it pushes and pops at the bottom, and
+   when it runs dry, steals from the top of someone else's.  A task is
+   either a whole file, which its worker opens and cuts into chunks of
+   GREP_CHUNK match starts (pushed back onto its own deque, so idle
+   workers can steal the rest of a big file), or one of those chunks.
+   Files are only mapped while their chunks are being searched. */
+#define GREP_THREADS 64
+#define GREP_CHUNK   (32 << 20)
 
-		for (a = &buf[0];  isspace(*a); a++);
-		if (!*a || *a == '#') continue;
-		for (b = a;       !isspace(*b); b++);
-		*b++ = '\0';
+typedef struct {
+	const char *path;
+	int fd;
+	uint8_t *data;
+	size_t len;
+	size_t left;            /* chunks not yet searched */
+} GREPFILE;
 
-		if (strcmp(a, "layout") == 0) {
-			for (a = b; isspace(*a); a++);
-			free(c->layout);
-			c->layout = strdup(a);
-			continue;
-		}
-		if (strcmp(a, "status") == 0) {
-			for (a = b; isspace(*a); a++);
-			if (c->status && strlen(c->status) > 0) {
-				b = calloc(strlen(c->status) + 1 + strlen(a) + 1, sizeof(char));
-				if (!b) {
-					printw("memory allocation failed while configuring statusbar.\n");
-					anyexit(1);
-				}
-				sprintf(b, "%s\n%s", c->status, a);
-				c->status = b;
+typedef struct {
+	int file;
+	int whole;              /* open and cut up the file? */
+	size_t from, to;        /* ... or, the match starts to try */
+} GREPTASK;
 
-			} else {
-				c->status = strdup(a);
-				if (!c->status) {
-					printw("memory allocation failed while configuring statusbar.\n");
-					anyexit(1);
-				}
+typedef struct GREP GREP;
+typedef struct {
+	pthread_mutex_t lock;
+	GREPTASK *task;         /* task[top .. bot) are waiting */
+	size_t top, bot, cap;
+	pthread_t tid;
+	int started;
+	PATTERN p;              /* each worker's own; bit searches keep state */
+	GREP *g;
+	int id;
+} GREPQ;
+
+struct GREP {
+	GREPFILE *files;
+	int nfiles;
+	GREPQ *q;
+	int nq;
+	size_t pending;         /* tasks queued or in hand */
+	pthread_mutex_t lock;   /* for the rest: */
+	int first;              /* the first file with a match (-1 = none) */
+	size_t first_at;        /* and where in it */
+	size_t hits;
+	int errors;
+};
+
+static int grep_push(GREPQ *q, GREPTASK t)
+{
+	GREPTASK *n;
+	size_t cap;
+
+	pthread_mutex_lock(&q->lock);
+	if (q->bot == q->cap) {
+		if (q->top > 0) { /* slide the waiting tasks down */
+			memmove(q->task, q->task + q->top, (q->bot - q->top) * sizeof(GREPTASK));
+			q->bot -= q->top;
+			q->top  = 0;
+		} else {
+			cap = q->cap ? q->cap * 2 : 64;
+			if (!(n = realloc(q->task, cap * sizeof(GREPTASK)))) {
+				pthread_mutex_unlock(&q->lock);
+				return -1;
 			}
-			continue;
+			q->task = n;
+			q->cap  = cap;
 		}
-
-		printw("Invalid configuration on line %d: '%s'\n", line, buf);
-		anyexit(1);
 	}
+	q->task[q->bot++] = t;
+	__atomic_fetch_add(&q->g->pending, 1, __ATOMIC_RELAXED);
+	pthread_mutex_unlock(&q->lock);
+	return 0;
+}
 
-	fclose(io);
+/* takes the newest task (own = 1) or the oldest (when stealing) */
+static int grep_take(GREPQ *q, int own, GREPTASK *t)
+{
+	int ok;
 
-	if (!c->layout) c->layout = strdup(DEFAULT_LAYOUT);
-	if (!c->status) c->status = strdup(DEFAULT_STATUS);
-	return c;
+	pthread_mutex_lock(&q->lock);
+	ok = q->bot > q->top;
+	if (ok) *t = own ? q->task[--q->bot] : q->task[q->top++];
+	pthread_mutex_unlock(&q->lock);
+	return ok;
 }
 
-static uint8_t * mapfile(const char *path, size_t *len)
+static void grep_close(GREPFILE *f)
 {
-	int fd;
-	void *addr;
+	if (f->data) munmap(f->data, f->len);
+	if (f->fd >= 0) close(f->fd);
+	f->data = NULL;
+	f->fd = -1;
+}
 
-	if (!len) {
-		printw("BUG: mapfile() called with NULL len argument.\n");
-		anyexit(1);
+/* opens a file, and queues its chunks */
+static void grep_open(GREPQ *q, GREPFILE *f, int file)
+{
+	GREPTASK t;
+	struct stat st;
+	size_t last, n, k;
+
+	f->fd = open(f->path, O_RDONLY);
+	if (f->fd < 0 || fstat(f->fd, &st) != 0) {
+		fprintf(stderr, "vex: %s: %s\n", f->path, strerror(errno));
+		goto fail;
 	}
-
-	fd = open(path, O_RDONLY);
-	if (fd < 0) {
-		printw("ERROR: %s\n", strerror(errno));
-		anyexit(1);
+	if (!S_ISREG(st.st_mode)) {
+		fprintf(stderr, "vex: %s: not a regular file\n", f->path);
+		goto fail;
 	}
-
-	*len = lseek(fd, 0, SEEK_END);
-	addr = mmap(NULL, *len, PROT_READ, MAP_PRIVATE, fd, 0);
-	if (addr == MAP_FAILED) {
-		printw("ERROR: %s\n", strerror(errno));
-		anyexit(1);
+	f->len = st.st_size;
+	if (f->len < pat_min(&q->p)) {
+		grep_close(f);
+		return;
+	}
+	f->data = mmap(NULL, f->len, PROT_READ, MAP_PRIVATE, f->fd, 0);
+	if (f->data == MAP_FAILED) {
+		f->data = NULL;
+		fprintf(stderr, "vex: %s: %s\n", f->path, strerror(errno));
+		goto fail;
 	}
+	madvise(f->data, f->len, MADV_SEQUENTIAL);
+
+	/* the last chunk is pushed first, so this worker starts at the
+	   front of the file and thieves take from the back */
+	last = f->len - pat_min(&q->p) + 1;
+	n = (last + GREP_CHUNK - 1) / GREP_CHUNK;
+	__atomic_store_n(&f->left, n, __ATOMIC_RELAXED);
+	for (k = n; k-- > 0; ) {
+		t.file  = file;
+		t.whole = 0;
+		t.from  = k * GREP_CHUNK;
+		t.to    = min(t.from + GREP_CHUNK, last);
+		if (grep_push(q, t) != 0) break;
+	}
+	if (k != (size_t)-1) { /* out of memory; forget the chunks that weren't queued */
+		fprintf(stderr, "vex: %s: %s\n", f->path, strerror(ENOMEM));
+		pthread_mutex_lock(&q->g->lock);
+		q->g->errors++;
+		pthread_mutex_unlock(&q->g->lock);
+		if (__atomic_sub_fetch(&f->left, k + 1, __ATOMIC_ACQ_REL) == 0) grep_close(f);
+	}
+	return;
 
-	return addr;
+fail:
+	grep_close(f);
+	pthread_mutex_lock(&q->g->lock);
+	q->g->errors++;
+	pthread_mutex_unlock(&q->g->lock);
 }
 
-int lopen(LAYOUT *l, const char *path)
+static void grep_chunk(GREPQ *q, GREPFILE *f, int file, size_t a, size_t b)
 {
-	l->data = mapfile(path, &(l->len));
-	if (!l->data) return 0; /* failed */
-
-	l->path = strdup(path);
-	l->file = strrchr(l->path, '/');
-	if (l->file) l->file++;
-	else l->file = l->path;
-	return 1;
+	GREP *g;
+	long at;
+
+	g = q->g;
+	while (a < b && psearch(&q->p, f->data, f->len, a, b, 1, &at) == 0) {
+		printf("%s:%ld\n", f->path, at);
+		pthread_mutex_lock(&g->lock);
+		g->hits++;
+		if (g->first < 0 || file < g->first || (file == g->first && (size_t)at < g->first_at)) {
+			g->first    = file;
+			g->first_at = at;
+		}
+		pthread_mutex_unlock(&g->lock);
+		a = at + 1;
+	}
+	if (__atomic_sub_fetch(&f->left, 1, __ATOMIC_ACQ_REL) == 0) grep_close(f);
 }
-/* }}} */
 
-LAYOUT* layout(CONFIG *c, int width)
+static void* grep_worker(void *_)
 {
-	LAYOUT *l;
-	int i, x;
+	GREPQ *q;
+	GREP *g;
+	GREPTASK t;
+	int i;
 
-	l = calloc(1, sizeof(LAYOUT));
-	if (!l) return NULL;
+	q = (GREPQ *)_;
+	g = q->g;
+	memset(&t, 0, sizeof(t));
+	for (;;) {
+		if (!grep_take(q, 1, &t)) {
+			for (i = 1; i < g->nq && !grep_take(&g->q[(q->id + i) % g->nq], 0, &t); i++);
+			if (i == g->nq) {
+				if (__atomic_load_n(&g->pending, __ATOMIC_ACQUIRE) == 0) break;
+				sched_yield(); /* someone is still cutting up a file */
+				continue;
+			}
+		}
+		if (t.whole) grep_open(q, &g->files[t.file], t.file);
+		else         grep_chunk(q, &g->files[t.file], t.file, t.from, t.to);
+		__atomic_sub_fetch(&g->pending, 1, __ATOMIC_ACQ_REL);
+	}
+	return NULL;
+}
 
-	l->st_height = 1;
-	for (i = 0; i < strlen(c->status); i++) {
-		if (c->status[i] == '\n') l->st_height++;
+/* greps the n files for `pattern`; returns 0 if there were matches, 1
+   if not, or 2 if something went wrong.  *first and *at are set to the
+   first match, in the order the files were given */
+int grep(const char *pattern, char **paths, int n, int *first, size_t *at)
+{
+	GREP g;
+	GREPTASK t;
+	PATTERN p;
+	int i, k, rc;
+
+	*first = -1;
+	if (pat_compile(NULL, &p, pattern) != 0) return 2;
+
+	rc = 2;
+	memset(&g, 0, sizeof(g));
+	g.first  = -1;
+	g.nfiles = n;
+	g.nq     = nworkers(GREP_THREADS);
+	g.files  = calloc(n, sizeof(GREPFILE));
+	g.q      = calloc(g.nq, sizeof(GREPQ));
+	if (!g.files || !g.q) {
+		fprintf(stderr, "vex: %s\n", strerror(ENOMEM));
+		free(g.files);
+		free(g.q);
+		return 2;
+	}
+	pthread_mutex_init(&g.lock, NULL);
+	for (i = 0; i < g.nq; i++) {
+		pthread_mutex_init(&g.q[i].lock, NULL);
+		g.q[i].g  = &g;
+		g.q[i].id = i;
+		g.q[i].p  = p;
+	}
+	/* dealt out backwards, so each worker starts on its earliest file */
+	for (i = n; i-- > 0; ) {
+		g.files[i].path = paths[i];
+		g.files[i].fd   = -1;
+		t.file  = i;
+		t.whole = 1;
+		t.from  = t.to = 0;
+		if (grep_push(&g.q[i % g.nq], t) != 0) {
+			fprintf(stderr, "vex: %s\n", strerror(ENOMEM));
+			goto done;
+		}
 	}
 
-	l->status = newwin(l->st_height, COLS, LINES - l->st_height - 1, 0);
-	wattron(l->status, C_STATUS);
-	wprintw(l->status, "%*s", COLS, "");
+	for (k = i = 0; i < g.nq; i++) {
+		g.q[i].started = pthread_create(&g.q[i].tid, NULL, grep_worker, &g.q[i]) == 0;
+		k += g.q[i].started;
+	}
+	if (k == 0) grep_worker(&g.q[0]); /* no threads at all; do it all here */
+	for (i = 0; i < g.nq; i++) {
+		if (g.q[i].started) pthread_join(g.q[i].tid, NULL);
+	}
+	fflush(stdout);
 
-	l->command = newwin(1, COLS, LINES - 1, 0);
+	*first = g.first;
+	*at    = g.first_at;
+	rc = g.errors ? 2 : g.hits ? 0 : 1;
 
-	l->nfields = parse_status(c->status, NULL);
-	if (l->nfields < 0) return NULL;
-	l->fields = calloc(l->nfields, sizeof(FIELD));
-	parse_status(c->status, l->fields);
+done:
+	for (i = 0; i < g.nq; i++) {
+		free(g.q[i].task);
+		pthread_mutex_destroy(&g.q[i].lock);
+	}
+	pthread_mutex_destroy(&g.lock);
+	free(g.files);
+	free(g.q);
+	return rc;
+}
+/* }}} */
+/* ex commands {{{ */
+int cmd_record(LAYOUT *l, int argc, char **argv)
+{
+	size_t n;
+	char *end;
 
-	l->ncol = strlen(c->layout);
-	l->main_height = LINES - l->st_height;
-	l->width = width;
-	l->columns = calloc(l->ncol, sizeof(COLUMN));
-	if (!l->columns) return NULL;
+	if (!l->table) {
+		errorf(l, "Not in table view");
+		return -1;
+	}
+	if (argc != 2) {
+		errorf(l, "usage: :record N");
+		return -1;
+	}
+	n = strtoul(argv[1], &end, 0);
+	if (*end || n >= l->table->nrec) {
+		errorf(l, "Record %s is out of range (0-%zu)", argv[1], l->table->nrec - 1);
+		return -1;
+	}
+	l->table->rec = n;
+	draw(l);
+	return 0;
+}
 
+int cmd_table(LAYOUT *l, int argc, char **argv)
+{
+	STRUCTDEF *def;
+	size_t stride;
+	char *end;
+	int i;
 
-	x = 1;
-	for (i = 0; i < l->ncol; i++) {
-		switch (c->layout[i]) {
-		case 'X': x += cfgcol(l, &l->columns[i], pr_hex_pretty, x, 3, 1); break;
-		case 'x': x += cfgcol(l, &l->columns[i], pr_hex,        x, 3, 1); break;
-		case 'a': x += cfgcol(l, &l->columns[i], pr_ascii,      x, 1, 0); break;
-		case 'O': x += cfgcol(l, &l->columns[i], pr_oct_pretty, x, 4, 1); break;
-		case 'o': x += cfgcol(l, &l->columns[i], pr_oct,        x, 4, 1); break;
-		default:
-			printw("bad layout type '%c'\n", c->layout[i]);
-			anyexit(1);
-			break;
+	if (argc < 2 || argc > 3) {
+		errorf(l, "usage: :table STRUCT [STRIDE]");
+		return -1;
+	}
+
+	def = NULL;
+	for (i = 0; i < l->nstructs; i++) {
+		if (strcmp(l->structs[i].name, argv[1]) == 0) def = &l->structs[i];
+	}
+	if (!def) {
+		errorf(l, "No such struct: %s", argv[1]);
+		return -1;
+	}
+
+	stride = 0;
+	if (argc == 3) {
+		stride = strtoul(argv[2], &end, 0);
+		if (*end || stride == 0) {
+			errorf(l, "Invalid stride: %s", argv[2]);
+			return -1;
 		}
 	}
 
-	return l;
+	if (ltable(l, def, stride) != 0) {
+		if (errno == ERANGE) errorf(l, "No room for a %s record at the cursor", def->name);
+		else                 errorf(l, "Can't show %s records: %s", def->name, strerror(errno));
+		return -1;
+	}
+	draw(l);
+	return 0;
 }
 
-/* drawing functions {{{ */
-void draw(LAYOUT *l)
+int cmd_goto(LAYOUT *l, int argc, char **argv)
 {
-	int i, j, max;
+	INDEX *ix;
+	SYMBOL *sym;
+	size_t at;
+	char *end;
 
-	max = l->width * l->main_height;
-	if (max > l->len - l->offset) {
-		max = l->len - l->offset;
+	if (argc != 2) {
+		errorf(l, "usage: :goto SYMBOL|OFFSET");
+		return -1;
 	}
 
-	for (i = 0; i < l->ncol; i++) {
-		wclear(l->columns[i].win);
-		for (j = 0; j < max; j++) {
-			if (j == l->pos) wattron(l->columns[i].win, C_CURSOR);
-			(*l->columns[i].pr)(l->columns[i].win, *DATA_AT(l, j));
-			if (j == l->pos) wattroff(l->columns[i].win, C_CURSOR);
+	at = strtoul(argv[1], &end, 0);
+	if (!*end && l->src && l->src->fill == proc_fill) { /* an address */
+		if (proc_off(l->src, at, &at) != 0) {
+			errorf(l, "%s isn't in a readable mapping of %s", argv[1], l->file);
+			return -1;
 		}
-		wnoutrefresh(l->columns[i].win);
+	} else if (*end) {
+		ix = lindex(l);
+		if (!ix) {
+			errorf(l, "Still indexing %s; try again in a moment", l->file);
+			return -1;
+		}
+		if (!ix->format) {
+			errorf(l, "%s is not an ELF, PE or Mach-O file", l->file);
+			return -1;
+		}
+		sym = ix_lookup(ix, argv[1]);
+		if (!sym) {
+			errorf(l, "No such symbol or section: %s", argv[1]);
+			return -1;
+		}
+		at = sym->offset;
+	}
+	if (at >= l->len) {
+		errorf(l, "Offset %s is past the end of %s", argv[1], l->file);
+		return -1;
 	}
 
-	statusbar(l);
-	doupdate();
+	if (l->table) ltable_close(l);
+	lgoto(l, at);
+	draw(l);
+	return 0;
 }
-/* }}} */
-/* movement functions {{{ */
-void lpage(LAYOUT *l, int delta)
+
+int cmd_strings(LAYOUT *l, int argc, char **argv)
 {
-	int page = l->width * l->main_height;
+	long min;
+	char *end;
 
-	delta *= page;
-	if (delta < 0) {
-		if (-1 * delta > l->offset) {
-			l->offset = 0;
-			draw(l);
-			return;
+	min = 4;
+	if (argc > 2) {
+		errorf(l, "usage: :strings [MIN]");
+		return -1;
+	}
+	if (argc == 2) {
+		min = strtol(argv[1], &end, 0);
+		if (*end || min < 1 || min > 1024) {
+			errorf(l, "Invalid minimum string length: %s", argv[1]);
+			return -1;
 		}
-	} else if (l->offset + delta > (l->len + 1) - ((l->len + 1) % page)) {
-		l->offset = (l->len + 1) - ((l->len + 1) % page);
-		draw(l);
-		return;
 	}
-
-	l->offset += delta;
-	if (l->offset >= l->len) {
-		l->offset = l->len - 1;
+	if (lstrings(l, min) != 0) {
+		errorf(l, "Couldn't extract strings from %s", l->file);
+		return -1;
 	}
 	draw(l);
+	return 0;
 }
 
-void lmove(LAYOUT *l, int delta)
+int cmd_annotate(LAYOUT *l, int argc, char **argv)
 {
-	int i, x, y, new, max;
+	ANNOTS *an;
 
-	/* FIXME: assuming no need for page shifting */
-	new = l->offset + l->pos + delta;
-	if (new >= l->len) delta = l->len - (l->offset + l->pos) - 1;
-	if (delta == 0 || new < 0) return;
+	if (argc > 2) {
+		errorf(l, "usage: :annotate [FILE]");
+		return -1;
+	}
+	an = NULL;
+	if (argc == 2 && !(an = annot_load(l, argv[1]))) return -1;
 
-	new = l->pos + delta;
-	max = (l->main_height - 1) * l->width;
-	if (new < 0 || new >= max) {
-		while (new < 0 && l->offset >= l->width) { /* page up */
-			l->offset -= l->width;
-			new += l->width;
-		}
-		while (new >= max) { /* page down */
-			l->offset += l->width;
-			new -= l->width;
+	annot_free(l->annots);
+	l->annots = an;
+	draw(l);
+	if (an) notef(l, "%zu annotations from %s", an->n, an->path);
+	return 0;
+}
+
+int cmd_plot(LAYOUT *l, int argc, char **argv)
+{
+	size_t from, to, n, size;
+	int kind, bits;
+	char *end;
+
+	if (argc < 2 || argc > 3) {
+		errorf(l, "usage: :plot TYPE [COUNT]");
+		return -1;
+	}
+	end  = argv[1] + (argv[1][0] == '%');
+	bits = strtol(end, &end, 10);
+	if      (strcmp(end, "ud") == 0) kind = PLOT_U;
+	else if (strcmp(end, "sd") == 0) kind = PLOT_S;
+	else if (strcmp(end, "f")  == 0) kind = PLOT_F;
+	else kind = -1;
+	if (kind < 0 || (bits != 8 && bits != 16 && bits != 32 && bits != 64)
+	 || (kind == PLOT_F && bits < 32)) {
+		errorf(l, "Invalid sample type: %s (try 16sd, 8ud or 32f)", argv[1]);
+		return -1;
+	}
+	size = bits / 8;
+
+	/* the selection, or else everything from the cursor on */
+	from = l->offset + l->pos;
+	to   = l->len;
+	if (l->marking) {
+		from = min(l->mark, l->offset + l->pos);
+		to   = max(l->mark, l->offset + l->pos) + 1;
+	}
+	n = min((to - from) / size, PLOT_DEFAULT);
+	if (argc == 3) {
+		n = strtoul(argv[2], &end, 0);
+		if (*end || n == 0 || n > (to - from) / size || n > PLOT_MAX) {
+			errorf(l, "Invalid sample count: %s (at most %zu)", argv[2],
+				min((to - from) / size, PLOT_MAX));
+			return -1;
 		}
-		l->pos = new;
-		draw(l);
-		return;
+	}
+	if (n == 0) {
+		errorf(l, "No room for a %s sample at the cursor", argv[1]);
+		return -1;
 	}
 
-	y = l->pos / l->width;
+	if (lplot(l, kind, bits, from, n) != 0) {
+		errorf(l, "Couldn't plot %zu samples", n);
+		return -1;
+	}
+	draw(l);
+	return 0;
+}
 
-	for (i = 0; i < l->ncol; i++) {
-		x = (l->pos - (y * l->width)) * l->columns[i].width;
-		wmove(l->columns[i].win, y, x);
-		(*l->columns[i].pr)(l->columns[i].win, *DATA_AT(l, l->pos));
+int cmd_scan(LAYOUT *l, int argc, char **argv)
+{
+	if (argc > 2) {
+		errorf(l, "usage: :scan [SIGNATURES-FILE]");
+		return -1;
 	}
-	l->pos += delta;
-	y = l->pos / l->width;
-	for (i = 0; i < l->ncol; i++) {
-		x = (l->pos - (y * l->width)) * l->columns[i].width;
-		wmove(l->columns[i].win, y, x);
-		wattron(l->columns[i].win, C_CURSOR);
-		(*l->columns[i].pr)(l->columns[i].win, *DATA_AT(l, l->pos));
-		wattroff(l->columns[i].win, C_CURSOR);
-		wnoutrefresh(l->columns[i].win);
+	if (lscan(l, argc == 2 ? argv[1] : NULL) != 0) return -1;
+	draw(l);
+	return 0;
+}
+
+int cmd_key(LAYOUT *l, int argc, char **argv)
+{
+	static const char *ops[] = { "none", "xor", "add", "rol" };
+	unsigned long key;
+	char *end;
+	int op;
+
+	key = 0;
+	for (op = 0; argc >= 2 && op < 4 && strcmp(argv[1], ops[op]) != 0; op++);
+	if (argc >= 2 && op < 4 && op != KEY_NONE && argc == 3) {
+		key = strtoul(argv[2], &end, 16);
+		if (*end || key > (op == KEY_ROL ? 7 : 255)) op = 4;
+	} else if (!(argc == 2 && op == KEY_NONE)) {
+		op = 4;
+	}
+	if (op == 4) {
+		errorf(l, "usage: :key none | :key xor|add|rol HEXKEY");
+		return -1;
 	}
 
-	statusbar(l);
-	doupdate();
+	l->keyop = op;
+	l->key   = key;
+	draw(l);
+	return 0;
 }
-/* }}} */
-/* searching functions {{{ */
-int query(LAYOUT *l, char type, char *buf, size_t len)
-{
-	WINDOW *win;
-	size_t n;
-	int c;
 
-	win = newwin(1, COLS, LINES - 1, 0);
-	waddch(win, type);
+int cmd_stride(LAYOUT *l, int argc, char **argv)
+{
+	if (argc != 1) {
+		errorf(l, "usage: :stride");
+		return -1;
+	}
+	if (lstride(l) != 0) {
+		errorf(l, "Couldn't sample %s for a stride", l->file);
+		return -1;
+	}
+	notef(l, "Looking for a stride around offset %zu...", l->offset + l->pos);
+	return 0;
+}
 
-	n = 0;
-	for (;;) {
-		wrefresh(win);
-		c = getch();
-		if (c == KEY_ENTER || c == '\n' || c == '\r') {
-			/* we can re-use the last query ... */
-			if (n > 0) buf[n] = '\0';
-			return 0;
+int cmd_width(LAYOUT *l, int argc, char **argv)
+{
+	long width, most, rows, at;
+	char *end;
+
+	most = lmaxwidth(l);
+	if (argc == 2) {
+		width = strtol(argv[1], &end, 0);
+		if (*end || width < 1) {
+			errorf(l, "Invalid width: %s", argv[1]);
+			return -1;
+		}
+		if (width > most) {
+			errorf(l, "Only room for %ld octets a row", most);
+			return -1;
 		}
-		if (isprint(c)) {
-			buf[n++] = c;
 
-			if (n == len) {
-				errno = ENOBUFS;
-				return -1; /* error! */
-			}
+	} else if (argc == 1 && l->stride && l->stride->job.done && l->stride->period) {
+		/* records too wide for the screen take several rows each,
+		   but every record still starts a row of its own */
+		for (width = min(l->stride->period, most); l->stride->period % width; width--);
 
-			waddch(win, c);
-			wrefresh(win);
-			continue;
-		}
+	} else {
+		errorf(l, "usage: :width OCTETS (or just :width, after :stride)");
+		return -1;
+	}
 
-		printw("unrec. char code %02x\n", c);
-		refresh(); getch();
+	at   = l->offset + l->pos;
+	rows = l->pos / l->width;
+	if (lwidth(l, width) != 0) {
+		errorf(l, "Only room for %ld octets a row", most);
+		return -1;
 	}
+	l->offset = at - at % width;
+	l->offset -= min(rows, l->offset / width) * width;
+	l->pos    = at - l->offset;
+	if (l->record >= 0 && lrecord(l, l->record) != 0) lrecord(l, -1);
+
+	werase(stdscr); /* the old columns may have reached further */
+	wnoutrefresh(stdscr);
+	draw(l);
+	if (argc == 1 && width != l->stride->period) {
+		notef(l, "%d-octet records, %ld octets a row", l->stride->period, width);
+	}
+	return 0;
 }
 
-int searchin(uint8_t *haystack, int a, int b, int step, char *needle, size_t len, int *out)
+int cmd_write(LAYOUT *l, int argc, char **argv)
 {
-	int i, ok;
-
-	/* FIXME: super dumb string search; look at boyer-moore */
-	for (; a >= 0 && a != b; a += step) {
-		if (haystack[a] != (uint8_t)(needle[0])) continue;
+	size_t a, b;
 
-		ok = 1;
-		for (i = 1; i < len; i++) {
-			if (haystack[a+i] != (uint8_t)(needle[i])) {
-				ok = 0;
-				break;
-			}
-		}
-		if (ok) {
-			*out = a;
-			return 0;
-		}
+	if (argc != 2) {
+		errorf(l, "usage: :write FILE (with a selection; v starts one)");
+		return -1;
 	}
+	if (!l->marking) {
+		errorf(l, "Nothing selected (v starts a selection)");
+		return -1;
+	}
+	a = min(l->mark, l->offset + l->pos);
+	b = max(l->mark, l->offset + l->pos) + 1;
+	if (lcarve(l, argv[1], a, min(b, l->len) - a) != 0) {
+		errorf(l, "Can't write %s: %s", argv[1], errno == EBUSY  ? "still writing the last one"
+		                                       : errno == EEXIST ? "it's the file being viewed" : strerror(errno));
+		return -1;
+	}
+	l->marking = 0;
+	draw(l);
+	lcarve_note(l);
+	return 0;
+}
 
-	return 1;
+int cmd_patch(LAYOUT *l, int argc, char **argv)
+{
+	if (lpatch(l) != 0) {
+		errorf(l, "Can't patch: %s", errno == ENOTSUP ? "only plain files can be (not decompressed or budgeted ones)" : strerror(errno));
+		return -1;
+	}
+	notef(l, "Patching; :poke changes octets, :save writes them back");
+	return 0;
 }
 
-void search(LAYOUT *l, char *pat)
+int cmd_poke(LAYOUT *l, int argc, char **argv)
 {
-	int rc, offset;
-	size_t len = strlen(pat);
+	uint8_t v[SCAN_PATLEN];
+	int i, n;
 
-	if (len == 0) {
-		errorf(l, "No search query provided.");
-		return;
+	if (argc < 2) {
+		errorf(l, "usage: :poke OCTETS (hex, or \"text\")");
+		return -1;
 	}
-
-	rc = searchin(l->data, l->offset + l->pos + 1, l->len - len, 1, pat, len, &offset);
-	if (rc == 0) {
-		lmove(l, offset - (l->offset + l->pos));
-		return;
+	for (i = 1; i + 1 < argc; i++) { /* put the words back together */
+		argv[i][strlen(argv[i])] = ' ';
 	}
-	rc = searchin(l->data, 0, min(l->offset + l->pos, l->len - len), 1, pat, len, &offset);
-	if (rc == 0) {
-		lmove(l, offset - (l->offset + l->pos));
-		return;
+	n = sig_pattern(argv[1], v, sizeof(v));
+	if (n <= 0) {
+		errorf(l, "Invalid octets: %s", argv[1]);
+		return -1;
 	}
-
-	errorf(l, "Pattern not found: %s", pat);
+	if (lpoke(l, l->offset + l->pos, v, n) != 0) {
+		errorf(l, "Can't poke: %s", errno == EPERM ? "not patching (:patch first)"
+		                          : errno == ERANGE ? "past the end of the file" : strerror(errno));
+		return -1;
+	}
+	draw(l);
+	return 0;
 }
 
-void rsearch(LAYOUT *l, char *pat)
+int cmd_save(LAYOUT *l, int argc, char **argv)
 {
-	int rc, offset;
-	size_t len = strlen(pat);
+	size_t n;
 
-	if (len == 0) {
-		errorf(l, "No search query provided.");
-		return;
+	if (argc == 2) { /* a patched copy, in the background */
+		if (lcarve(l, argv[1], 0, l->len) != 0) {
+			errorf(l, "Can't write %s: %s", argv[1], errno == EBUSY  ? "still writing the last one"
+		                                       : errno == EEXIST ? "it's the file being viewed" : strerror(errno));
+			return -1;
+		}
+		lcarve_note(l);
+		return 0;
 	}
-
-	rc = searchin(l->data, l->offset + l->pos - 1, 0, -1, pat, len, &offset);
-	if (rc == 0) {
-		lmove(l, offset - (l->offset + l->pos));
-		return;
+	if (argc != 1) {
+		errorf(l, "usage: :save [FILE]");
+		return -1;
 	}
-	rc = searchin(l->data, l->len - len, l->offset + l->pos, -1, pat, len, &offset);
-	if (rc == 0) {
-		lmove(l, offset - (l->offset + l->pos));
-		return;
+	if (lsave(l, &n) != 0) {
+		errorf(l, "Can't save %s: %s", l->path, strerror(errno));
+		return -1;
+	}
+	draw(l);
+	notef(l, "Saved %zu patched octets to %s", n, l->path);
+	return 0;
+}
+
+static struct {
+	const char *name;
+	int (*fn)(LAYOUT *, int, char **);
+} COMMANDS[] = {
+	{ "annotate", cmd_annotate },
+	{ "goto",    cmd_goto    },
+	{ "key",     cmd_key     },
+	{ "patch",   cmd_patch   },
+	{ "plot",    cmd_plot    },
+	{ "poke",    cmd_poke    },
+	{ "record",  cmd_record  },
+	{ "save",    cmd_save    },
+	{ "scan",    cmd_scan    },
+	{ "stride",  cmd_stride  },
+	{ "strings", cmd_strings },
+	{ "table",   cmd_table   },
+	{ "width",   cmd_width   },
+	{ "write",   cmd_write   },
+	{ NULL, NULL },
+};
+
+int command(LAYOUT *l, char *buf)
+{
+	char *argv[16], *p;
+	int argc, i;
+
+	argc = 0;
+	for (p = strtok(buf, " \t"); p && argc < 16; p = strtok(NULL, " \t")) {
+		argv[argc++] = p;
 	}
+	if (argc == 0) return 0;
 
-	errorf(l, "Pattern not found: %s", pat);
+	for (i = 0; COMMANDS[i].name; i++) {
+		if (strcmp(COMMANDS[i].name, argv[0]) == 0) {
+			return (*COMMANDS[i].fn)(l, argc, argv);
+		}
+	}
+	errorf(l, "Not an editor command: %s", argv[0]);
+	return -1;
 }
 /* }}} */
 
+/* are there any background jobs still running? */
+int lbusy(LAYOUT *l)
+{
+	return (l->table && !l->table->job.done)
+	    || (l->src && l->src->indexing && !l->src->job.done)
+	    || (l->index && !l->index->job.done)
+	    || (l->scan && !l->scan->job.done)
+	    || (l->stride && !l->stride->job.done)
+	    || (l->dups && !l->dups->job.done)
+	    || (l->carve && !l->carve->job.done)
+	    || (l->plot && !l->plot->job.done)
+	    || (l->strings && (!l->strings->job.done || !l->strings->fjob.done || l->strings->stale));
+}
+
+/* stops (and joins) everything lbusy() could be waiting on, so that
+   nothing is left reading the image, or half-writing a file, at exit */
+static void lquit(LAYOUT *l)
+{
+	lindex_free(l);
+	lcarve_free(l);
+	lstride_free(l);
+	lplot_free(l);
+	lstrings_free(l);
+	if (l->table) job_stop(&l->table->job);
+	if (l->scan)  job_stop(&l->scan->job);
+	if (l->dups)  job_stop(&l->dups->job);
+	if (l->src)   job_stop(&l->src->job);
+}
+
 int main(int argc, char **argv)
 {
 	LAYOUT *l;
+	int raw = 0, rc, first, open_first;
+	pid_t pid = 0;
+	size_t at = 0;
+	char *end, *me, *pattern = NULL;
+
+	me = argv[0];
+	if (argc >= 3 && strcmp(argv[1], "--grep") == 0) { /* many files, no screen */
+		argc--; argv++;
+		open_first = 0;
+		for (; argc >= 2 && !pattern; argc--, argv++) {
+			if (strcmp(argv[1], "--open-first") == 0) open_first = 1;
+			else pattern = argv[1];
+		}
+		if (argc >= 2 && strcmp(argv[1], "--open-first") == 0) {
+			open_first = 1;
+			argc--; argv++;
+		}
+		if (!pattern || argc < 2) {
+			fprintf(stderr, "USAGE: %s --grep [--open-first] PATTERN file...\n", me);
+			exit(2);
+		}
+		rc = grep(pattern, argv + 1, argc - 1, &first, &at);
+		if (!open_first || first < 0) return rc;
+		argv[1] = argv[1 + first];
+		argc = 2;
+		raw  = 1; /* the offset is into the file as grep read it */
+	}
 
+	if (argc == 3 && strcmp(argv[1], "-R") == 0) { /* don't decompress */
+		raw = 1;
+		argc--; argv++;
+	} else if (argc == 3 && strcmp(argv[1], "-p") == 0) { /* a live process */
+		pid = strtol(argv[2], &end, 10);
+		if (*end || pid <= 0) argc = 0;
+		argc--; argv++;
+	}
 	if (argc != 2) {
-		fprintf(stderr, "USAGE: %s file\n", argv[0]);
+		fprintf(stderr, "USAGE: %s [-R] file\n"
+		                "       %s -p PID\n"
+		                "       %s --grep [--open-first] PATTERN file...\n", argv[0], argv[0], argv[0]);
 		exit(1);
 	}
 
@@ -1130,6 +8916,7 @@ int main(int argc, char **argv)
 		return 0;
 	}
 
+	setlocale(LC_CTYPE, ""); /* for the text columns */
 	initscr();
 	cbreak();
 	keypad(stdscr, TRUE); /* for the arrow keys */
@@ -1138,47 +8925,118 @@ int main(int argc, char **argv)
 	the_colors();
 	refresh();
 
-	l = layout(configure(), 16);
+	l = layout(configure());
 	if (!l) {
 		printw("layout() failed...\n");
 		anyexit(1);
 	}
-	if (!lopen(l, argv[1])) {
+	if (!(pid ? lopen_pid(l, pid) : lopen(l, argv[1], raw))) {
 		printw("lopen() failed...\n");
 		anyexit(1);
 	}
-	draw(l);
 
+	int c, busy = 0;
 	int quant = 0;
 	char q[8192] = {0};
+	char cmd[8192];
+
+	if (pattern) { /* --open-first: on the first match, with n finding the next */
+		snprintf(q, sizeof(q), "%s", pattern);
+		lgoto(l, at);
+	}
+	draw(l);
+	if (pid && proc_dropped(l->src)) {
+		errorf(l, "Left out %zu mapping%s too big to fit", proc_dropped(l->src),
+			proc_dropped(l->src) == 1 ? "" : "s");
+	}
 	for (;;) {
-		int c = getch();
-		if (c == 'q') break;
+		if (busy && !lbusy(l)) draw(l); /* show the final results */
+		lstride_note(l);
+		lcarve_note(l);
+		busy = lbusy(l);
+		timeout(busy ? 250 : -1);
+
+		c = getch();
+		if (c == ERR) {
+			if (busy) draw(l);
+			continue;
+		}
+		if (c == KEY_RESIZE) {
+			lconfigure(l, l->config);
+			draw(l);
+			continue;
+		}
+		if (l->pane == P_STRINGS && skey(l, c, quant)) {
+			quant = 0;
+			continue;
+		}
+		if (l->pane == P_HITS && hkey(l, c, quant)) {
+			quant = 0;
+			continue;
+		}
+		if (l->pane == P_PLOT && pkey(l, c, quant)) {
+			quant = 0;
+			continue;
+		}
+		if (c == 'q') {
+			if (!l->ndirty || l->quitting) break;
+			l->quitting = 1;
+			errorf(l, "Unsaved patches (:save writes them; q again drops them)");
+			continue;
+		}
+		if (l->table && tkey(l, c, quant)) {
+			quant = 0;
+			continue;
+		}
 
 		switch (c) {
 		case 'r':
-			/* FIXME: leaks memory like a sieve */
-			l = layout(configure(), 16);
-			if (!l) {
+			if (lconfigure(l, configure()) != 0) {
 				printw("layout() failed...\n");
 				anyexit(1);
 			}
-			if (!lopen(l, argv[1])) {
-				printw("lopen() failed...\n");
-				anyexit(1);
+			draw(l);
+			break;
+
+		case 'S':
+			if (l->nstructs == 0) {
+				errorf(l, "No struct definitions in vexrc");
+				break;
+			}
+			if (lrecord(l, l->record + 1 < l->nstructs ? l->record + 1 : -1) != 0) {
+				errorf(l, "No room for the record panel");
+				break;
 			}
 			draw(l);
 			break;
 
+		case 'T':
+			if (l->nstructs == 0) {
+				errorf(l, "No struct definitions in vexrc");
+				break;
+			}
+			if (ltable(l, &l->structs[max(l->record, 0)], 0) != 0) {
+				if (errno == ERANGE) errorf(l, "No room for a %s record at the cursor", l->structs[max(l->record, 0)].name);
+				else                 errorf(l, "Can't show %s records: %s", l->structs[max(l->record, 0)].name, strerror(errno));
+				break;
+			}
+			draw(l);
+			break;
+
+		case ':':
+			cmd[0] = '\0';
+			if (query(l, ':', cmd, sizeof(cmd), NULL, NULL) == 0) command(l, cmd);
+			break;
+
 		case 'n':  search(l, q); break;
 		case 'N': rsearch(l, q); break;
-		case '/': if (query(l, '/', q, 8192) == 0)  search(l, q); break;
-		case '?': if (query(l, '?', q, 8192) == 0) rsearch(l, q); break;
+		case '/': isearch(l, '/', q, sizeof(q)); break;
+		case '?': isearch(l, '?', q, sizeof(q)); break;
 
 		case KEY_RIGHT: quant = 0; lmove(l,  1); break;
 		case KEY_LEFT:  quant = 0; lmove(l, -1); break;
-		case KEY_UP:    quant = 0; lmove(l, -1 * l->width); break;
-		case KEY_DOWN:  quant = 0; lmove(l,      l->width); break;
+		case KEY_UP:    quant = 0; lvmove(l, -1); break;
+		case KEY_DOWN:  quant = 0; lvmove(l,  1); break;
 
 		case '0':
 		case '1':
@@ -1195,15 +9053,32 @@ int main(int argc, char **argv)
 		case '-': lmove(l, -1 * (quant ? quant : 1)); quant = 0; break;
 
 		case 'h': lmove(l, -1 * (quant ? quant : 1));            quant = 0; break;
-		case 'j': lmove(l, -1 * (quant ? quant : 1) * l->width); quant = 0; break;
-		case 'k': lmove(l,      (quant ? quant : 1) * l->width); quant = 0; break;
+		case 'j': lvmove(l, -1 * (quant ? quant : 1)); quant = 0; break;
+		case 'k': lvmove(l,      (quant ? quant : 1)); quant = 0; break;
 		case 'l': lmove(l,      (quant ? quant : 1));            quant = 0; break;
+		case '}': lextent(l,  1); break;
+		case '{': lextent(l, -1); break;
+		case 'v':
+			l->marking = !l->marking;
+			l->mark    = l->offset + l->pos;
+			draw(l);
+			break;
+		case 27:
+			if (l->marking) {
+				l->marking = 0;
+				draw(l);
+			}
+			break;
+		case 'd': ldupjump(l,  1); break;
+		case 'D': ldupjump(l, -1); break;
+		case '<': lbit(l,  -1 * (quant ? quant : 1));            quant = 0; break;
+		case '>': lbit(l,       (quant ? quant : 1));            quant = 0; break;
 
 		case 'U' & 037:
 			if (l->pos < l->width || l->pos >= l->width * (l->main_height - 1)) {
 				lpage(l, -1);
 			} else {
-				lmove(l, -1 * (l->width * l->main_height) / 2);
+				lvmove(l, -1 * l->main_height / 2);
 			}
 			break;
 
@@ -1211,11 +9086,18 @@ int main(int argc, char **argv)
 			if (l->pos < l->width || l->pos >= l->width * (l->main_height - 1)) {
 				lpage(l, 1);
 			} else {
-				lmove(l, (l->width * l->main_height) / 2);
+				lvmove(l, l->main_height / 2);
 			}
 			break;
+
+		case 'L' & 037: /* read what's on screen again, and redraw it */
+			if (l->src) src_refill(l->src, l->offset, l->width * l->main_height);
+			clearok(curscr, TRUE);
+			draw(l);
+			break;
 		}
 	}
+	lquit(l);
 	endwin();
 	return 0;
 }